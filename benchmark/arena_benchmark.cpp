@@ -0,0 +1,80 @@
+/*!
+ * \file arena_benchmark.cpp
+ *
+ * \brief counts global allocations made while decoding a result set with and
+ * without a statement arena
+ * \date 2026-10-18
+ */
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#include "../hdr/mariadb_modern_cpp.hpp"
+#include "../test/test_config.hpp"
+
+static std::atomic<size_t> allocation_count{0};
+
+void *operator new(std::size_t size) {
+  allocation_count++;
+  if (auto ptr = std::malloc(size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+template <typename Function>
+static void measure(const char *name, Function f) {
+  const auto old_count = allocation_count.load();
+  const auto start = std::chrono::steady_clock::now();
+  f();
+  const auto end = std::chrono::steady_clock::now();
+  std::cout << name << ": " << allocation_count.load() - old_count
+            << " allocations, "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(end -
+                                                                      start)
+                   .count()
+            << " ms" << std::endl;
+}
+
+int main() {
+  constexpr size_t row_count = 100000;
+  mariadb::database db(get_test_config());
+
+  db << "CREATE TABLE IF NOT EXISTS mariadb_modern_cpp_test.arena_benchmark "
+        "(name VARCHAR(64), payload BLOB);";
+  db << "delete from arena_benchmark;";
+  {
+    auto ps = db << "insert into arena_benchmark values (?,?)";
+    // long enough to defeat the small string optimization
+    const std::string name(40, 'n');
+    const std::vector<std::byte> payload(256, std::byte{1});
+    for (size_t i = 0; i < row_count; i++) {
+      ps << name << payload;
+      ps.execute();
+    }
+  }
+
+  size_t total_size = 0;
+  measure("std::string/std::vector", [&] {
+    db << "select name,payload from arena_benchmark" >>
+        [&](std::string name, std::vector<std::byte> payload) {
+          total_size += name.size() + payload.size();
+        };
+  });
+
+  measure("std::pmr::string/std::pmr::vector with arena", [&] {
+    auto ps = db << "select name,payload from arena_benchmark";
+    ps.use_arena(mariadb::arena_reset::per_row);
+    ps >> [&](std::pmr::string name, std::pmr::vector<std::byte> payload) {
+      total_size += name.size() + payload.size();
+    };
+  });
+
+  db << "drop TABLE mariadb_modern_cpp_test.arena_benchmark;";
+  return total_size == 2 * row_count * (40 + 256) ? EXIT_SUCCESS
+                                                  : EXIT_FAILURE;
+}
@@ -0,0 +1,63 @@
+/*!
+ * \file escape_benchmark.cpp
+ *
+ * \brief compares binding string arguments through the vectorized scan with
+ * mysql_real_escape_string alone,no server is needed
+ * \date 2026-10-18
+ */
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "../hdr/mariadb_modern_cpp.hpp"
+
+template <typename Function>
+static double measure_ns(size_t iterations, Function f) {
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < iterations; i++) {
+    f();
+  }
+  const auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() /
+         iterations;
+}
+
+int main() {
+  // only the character set of the handle is used
+  std::unique_ptr<MYSQL, void (*)(MYSQL *)> db(mysql_init(nullptr),
+                                               mysql_close);
+  if (!db) {
+    return EXIT_FAILURE;
+  }
+  std::cout << "character set " << mysql_character_set_name(db.get())
+            << std::endl;
+  size_t total = 0;
+  for (size_t size : {8u, 32u, 128u, 1024u, 16384u}) {
+    const std::string clean(size, 'a');
+    std::string dirty = clean;
+    dirty.back() = '\'';
+    const size_t iterations = 64 * 1024 * 1024 / size;
+    std::string sql;
+    for (const std::string *input : {&clean, &std::as_const(dirty)}) {
+      const double writer_ns = measure_ns(iterations, [&] {
+        sql.clear();
+        mariadb::sql_writer(db.get(), sql)
+            .write_string(input->data(), input->size());
+        total += sql.size();
+      });
+      const double connector_ns = measure_ns(iterations, [&] {
+        sql.resize(input->size() * 2 + 2);
+        total += mysql_real_escape_string(db.get(), sql.data(), input->data(),
+                                          input->size());
+      });
+      std::cout << (input == &clean ? "clean " : "dirty ") << size
+                << " bytes: sql_writer " << writer_ns
+                << " ns, mysql_real_escape_string " << connector_ns << " ns"
+                << std::endl;
+    }
+  }
+  return total != 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,414 @@
+/*!
+ * \file loadgen.cpp
+ *
+ * \brief a sysbench-style workload generator,reporting latency histograms
+ * and throughput as JSON
+ * \date 2026-10-18
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../hdr/mariadb_modern_cpp.hpp"
+#include "../hdr/mariadb_modern_cpp/connection_pool.hpp"
+#include "../test/test_config.hpp"
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+// A log-linear histogram in the manner of HdrHistogram,values are kept to
+// three significant digits (1/1024 relative error).
+class latency_histogram {
+public:
+  void record(uint64_t value) {
+    const auto idx = _index(value);
+    if (idx >= _counts.size()) {
+      _counts.resize(idx + 1);
+    }
+    _counts[idx]++;
+    _count++;
+    _sum += value;
+    _min = std::min(_min, value);
+    _max = std::max(_max, value);
+  }
+
+  void merge(const latency_histogram &other) {
+    if (other._counts.size() > _counts.size()) {
+      _counts.resize(other._counts.size());
+    }
+    for (size_t i = 0; i < other._counts.size(); i++) {
+      _counts[i] += other._counts[i];
+    }
+    _count += other._count;
+    _sum += other._sum;
+    _min = std::min(_min, other._min);
+    _max = std::max(_max, other._max);
+  }
+
+  uint64_t count() const noexcept { return _count; }
+
+  // the highest value equivalent to the recorded one at `percentile`
+  uint64_t value_at(double percentile) const {
+    if (_count == 0) {
+      return 0;
+    }
+    auto rank = static_cast<uint64_t>(percentile / 100 * _count + 0.5);
+    rank = std::clamp<uint64_t>(rank, 1, _count);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < _counts.size(); i++) {
+      seen += _counts[i];
+      if (seen >= rank) {
+        return std::min(_highest_equivalent(i), _max);
+      }
+    }
+    return _max;
+  }
+
+  void write_json(std::ostream &os) const {
+    os << "{\"count\":" << _count << ",\"min\":" << (_count ? _min : 0)
+       << ",\"mean\":" << (_count ? _sum / _count : 0);
+    for (auto [name, percentile] :
+         {std::pair{"p50", 50.0}, {"p90", 90.0}, {"p99", 99.0},
+          {"p99.9", 99.9}, {"p99.99", 99.99}}) {
+      os << ",\"" << name << "\":" << value_at(percentile);
+    }
+    os << ",\"max\":" << _max << ",\"buckets\":[";
+    bool first = true;
+    for (size_t i = 0; i < _counts.size(); i++) {
+      if (_counts[i]) {
+        os << (first ? "" : ",") << '[' << _highest_equivalent(i) << ','
+           << _counts[i] << ']';
+        first = false;
+      }
+    }
+    os << "]}";
+  }
+
+private:
+  static constexpr unsigned sub_bucket_bits = 10;
+  static constexpr uint64_t sub_bucket_count = uint64_t(1) << sub_bucket_bits;
+
+  static unsigned _bit_width(uint64_t value) noexcept {
+    unsigned width = 0;
+    while (value) {
+      value >>= 1;
+      width++;
+    }
+    return width;
+  }
+
+  // values below 2*sub_bucket_count are exact,above that every power of two
+  // is split into sub_bucket_count buckets
+  static size_t _index(uint64_t value) noexcept {
+    if (value < 2 * sub_bucket_count) {
+      return value;
+    }
+    const auto shift = _bit_width(value) - sub_bucket_bits - 1;
+    return (shift + 1) * sub_bucket_count + (value >> shift) -
+           sub_bucket_count;
+  }
+
+  static uint64_t _highest_equivalent(size_t idx) noexcept {
+    if (idx < 2 * sub_bucket_count) {
+      return idx;
+    }
+    const auto shift = idx / sub_bucket_count - 1;
+    const auto sub = idx % sub_bucket_count + sub_bucket_count;
+    return ((sub + 1) << shift) - 1;
+  }
+
+  std::vector<uint64_t> _counts;
+  uint64_t _count{};
+  uint64_t _sum{};
+  uint64_t _min{UINT64_MAX};
+  uint64_t _max{};
+};
+
+enum operation : size_t {
+  point_select,
+  range_select,
+  insert,
+  update,
+  operation_count
+};
+constexpr const char *operation_names[operation_count] = {
+    "point_select", "range_select", "insert", "update"};
+
+struct options {
+  size_t threads{8};
+  size_t connections{8};
+  // operations per second over all threads,0 runs closed-loop
+  double rate{1000};
+  double duration{10};
+  uint64_t table_size{10000};
+  uint64_t range_size{100};
+  double mix[operation_count]{70, 10, 10, 10};
+  bool prepare{true};
+};
+
+struct worker_result {
+  latency_histogram latency[operation_count];
+  // from the actual start,excluding the time spent behind schedule
+  latency_histogram service;
+  uint64_t errors[operation_count]{};
+};
+
+[[noreturn]] void usage(const char *program) {
+  std::cerr
+      << "usage: " << program
+      << " [--host H] [--port P] [--user U] [--password P] [--database D]\n"
+         "  [--threads N] [--connections N] [--rate OPS_PER_SEC|0]\n"
+         "  [--duration SECONDS] [--table-size ROWS] [--range-size ROWS]\n"
+         "  [--mix POINT,RANGE,INSERT,UPDATE] [--skip-prepare]\n"
+         "Latencies are reported in microseconds. With a rate they are\n"
+         "measured from the scheduled start of each operation (open-loop),\n"
+         "so a stalled server is not hidden by a stalled client.\n";
+  std::exit(EXIT_FAILURE);
+}
+
+std::string sql_pad(std::mt19937_64 &rng, size_t length) {
+  std::string s(length, '0');
+  for (auto &c : s) {
+    c = static_cast<char>('0' + rng() % 10);
+  }
+  return s;
+}
+
+void prepare_table(mariadb::database &db, const options &opts) {
+  db << "DROP TABLE IF EXISTS loadgen_sbtest;";
+  db << "CREATE TABLE loadgen_sbtest (id BIGINT PRIMARY KEY, k INT NOT NULL,"
+        " c CHAR(120) NOT NULL, pad CHAR(60) NOT NULL, KEY (k));";
+  std::mt19937_64 rng(0);
+  constexpr uint64_t rows_per_transaction = 1000;
+  for (uint64_t id = 1; id <= opts.table_size;) {
+    auto tc = db.get_transaction_context();
+    for (uint64_t n = 0; n < rows_per_transaction && id <= opts.table_size;
+         n++, id++) {
+      tc << "insert into loadgen_sbtest values (?,?,?,?);" << id
+         << static_cast<int32_t>(rng() % opts.table_size) << sql_pad(rng, 119)
+         << sql_pad(rng, 59);
+    }
+  }
+}
+
+void run_operation(mariadb::database &db, operation op, std::mt19937_64 &rng,
+                   const options &opts, std::atomic<uint64_t> &next_id) {
+  const auto id = static_cast<int64_t>(rng() % opts.table_size + 1);
+  switch (op) {
+  case point_select: {
+    std::string c;
+    db << "select c from loadgen_sbtest where id=?;" << id >> c;
+    break;
+  }
+  case range_select: {
+    size_t rows = 0;
+    db << "select c from loadgen_sbtest where id between ? and ?;" << id
+       << id + static_cast<int64_t>(opts.range_size) - 1 >>
+        [&](std::string) { rows++; };
+    break;
+  }
+  case insert: {
+    const auto new_id = static_cast<int64_t>(next_id.fetch_add(1));
+    db << "insert into loadgen_sbtest values (?,?,?,?);" << new_id
+       << static_cast<int32_t>(rng() % opts.table_size) << sql_pad(rng, 119)
+       << sql_pad(rng, 59);
+    break;
+  }
+  case update: {
+    auto tc = db.get_transaction_context();
+    tc << "update loadgen_sbtest set k=k+1 where id=?;" << id;
+    tc << "update loadgen_sbtest set c=? where id=?;" << sql_pad(rng, 119)
+       << id;
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+void worker(size_t index, const options &opts, mariadb::connection_pool &pool,
+            clock_type::time_point start, clock_type::time_point end,
+            std::atomic<uint64_t> &next_id, worker_result &result) {
+  std::mt19937_64 rng(index + 1);
+  std::discrete_distribution<size_t> pick(std::begin(opts.mix),
+                                          std::end(opts.mix));
+  // each thread takes an evenly spaced share of the schedule,offset so the
+  // threads interleave
+  const auto interval =
+      opts.rate > 0 ? std::chrono::duration_cast<clock_type::duration>(
+                          std::chrono::duration<double>(opts.threads /
+                                                        opts.rate))
+                    : clock_type::duration::zero();
+  auto scheduled = start + interval * index / opts.threads;
+
+  while (true) {
+    auto now = clock_type::now();
+    if (opts.rate > 0) {
+      if (scheduled >= end) {
+        break;
+      }
+      if (scheduled > now) {
+        std::this_thread::sleep_until(scheduled);
+        now = clock_type::now();
+      }
+    } else {
+      if (now >= end) {
+        break;
+      }
+      scheduled = now;
+    }
+
+    const auto op = static_cast<operation>(pick(rng));
+    try {
+      auto db = pool.acquire();
+      run_operation(*db, op, rng, opts, next_id);
+    } catch (const mariadb::mariadb_exception &) {
+      result.errors[op]++;
+    }
+    const auto done = clock_type::now();
+    auto to_us = [](clock_type::duration d) {
+      return static_cast<uint64_t>(
+          std::chrono::duration_cast<std::chrono::microseconds>(d).count());
+    };
+    result.latency[op].record(to_us(done - scheduled));
+    result.service.record(to_us(done - now));
+    scheduled += interval;
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  auto config = get_test_config();
+  options opts;
+
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "--skip-prepare") {
+      opts.prepare = false;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      usage(argv[0]);
+    }
+    const char *value = argv[++i];
+    try {
+      if (arg == "--host") {
+        config.host = value;
+      } else if (arg == "--port") {
+        config.port = static_cast<unsigned int>(std::stoul(value));
+      } else if (arg == "--user") {
+        config.user = value;
+      } else if (arg == "--password") {
+        config.passwd = value;
+      } else if (arg == "--database") {
+        config.default_database = value;
+      } else if (arg == "--threads") {
+        opts.threads = std::max<size_t>(std::stoul(value), 1);
+      } else if (arg == "--connections") {
+        opts.connections = std::max<size_t>(std::stoul(value), 1);
+      } else if (arg == "--rate") {
+        opts.rate = std::stod(value);
+      } else if (arg == "--duration") {
+        opts.duration = std::stod(value);
+      } else if (arg == "--table-size") {
+        opts.table_size = std::max<uint64_t>(std::stoull(value), 1);
+      } else if (arg == "--range-size") {
+        opts.range_size = std::max<uint64_t>(std::stoull(value), 1);
+      } else if (arg == "--mix") {
+        std::string mix = value;
+        size_t pos = 0;
+        for (auto &weight : opts.mix) {
+          size_t used = 0;
+          weight = std::stod(mix.substr(pos), &used);
+          pos += used + 1;
+        }
+      } else {
+        usage(argv[0]);
+      }
+    } catch (const std::logic_error &) {
+      usage(argv[0]);
+    }
+  }
+
+  try {
+    mariadb::connection_pool pool(config, opts.connections);
+    if (opts.prepare) {
+      prepare_table(*pool.acquire(), opts);
+    }
+    std::atomic<uint64_t> next_id{0};
+    {
+      uint64_t max_id = 0;
+      *pool.acquire() << "select coalesce(max(id),0) from loadgen_sbtest;" >>
+          max_id;
+      next_id = max_id + 1;
+    }
+
+    std::vector<worker_result> results(opts.threads);
+    std::vector<std::thread> threads;
+    const auto start = clock_type::now();
+    const auto end = start + std::chrono::duration_cast<clock_type::duration>(
+                                 std::chrono::duration<double>(opts.duration));
+    for (size_t i = 0; i < opts.threads; i++) {
+      threads.emplace_back(worker, i, std::cref(opts), std::ref(pool), start,
+                           end, std::ref(next_id), std::ref(results[i]));
+    }
+    for (auto &t : threads) {
+      t.join();
+    }
+    const double elapsed =
+        std::chrono::duration<double>(clock_type::now() - start).count();
+
+    worker_result total;
+    latency_histogram all;
+    uint64_t errors = 0;
+    for (auto &r : results) {
+      for (size_t op = 0; op < operation_count; op++) {
+        total.latency[op].merge(r.latency[op]);
+        total.errors[op] += r.errors[op];
+        errors += r.errors[op];
+        all.merge(r.latency[op]);
+      }
+      total.service.merge(r.service);
+    }
+
+    auto &os = std::cout;
+    os << "{\"config\":{\"threads\":" << opts.threads
+       << ",\"connections\":" << opts.connections << ",\"rate\":" << opts.rate
+       << ",\"duration\":" << opts.duration
+       << ",\"table_size\":" << opts.table_size
+       << ",\"range_size\":" << opts.range_size << ",\"mix\":{";
+    for (size_t op = 0; op < operation_count; op++) {
+      os << (op ? "," : "") << '"' << operation_names[op]
+         << "\":" << opts.mix[op];
+    }
+    os << "}},\"elapsed_s\":" << elapsed << ",\"operations\":" << all.count()
+       << ",\"errors\":" << errors
+       << ",\"throughput_ops\":" << all.count() / elapsed
+       << ",\"latency_us\":";
+    all.write_json(os);
+    os << ",\"service_time_us\":";
+    total.service.write_json(os);
+    os << ",\"by_operation\":{";
+    for (size_t op = 0; op < operation_count; op++) {
+      os << (op ? "," : "") << '"' << operation_names[op]
+         << "\":{\"errors\":" << total.errors[op] << ",\"latency_us\":";
+      total.latency[op].write_json(os);
+      os << '}';
+    }
+    os << "}}" << std::endl;
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+}
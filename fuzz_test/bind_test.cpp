@@ -0,0 +1,134 @@
+/*!
+ * \file bind_test.cpp
+ *
+ * \brief binds string arguments into a sql template without a server and
+ * compares the text with a reference tokenizer and escaper
+ * \date 2026-10-18
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../hdr/mariadb_modern_cpp.hpp"
+#include "fuzz_timing.hpp"
+
+static const std::shared_ptr<MYSQL> &get_connection() {
+  // mysql_real_escape_string only needs the character set of an
+  // initialized handle,so it's never connected
+  static std::shared_ptr<MYSQL> db(mysql_init(nullptr),
+                                   [](MYSQL *ptr) { mysql_close(ptr); });
+  return db;
+}
+
+static void reference_escape(std::string_view str, std::string &out) {
+  out.push_back('\'');
+  for (char c : str) {
+    switch (c) {
+    case '\0':
+      out.append("\\0");
+      break;
+    case '\n':
+      out.append("\\n");
+      break;
+    case '\r':
+      out.append("\\r");
+      break;
+    case '\\':
+      out.append("\\\\");
+      break;
+    case '\'':
+      out.append("\\'");
+      break;
+    case '"':
+      out.append("\\\"");
+      break;
+    case '\032':
+      out.append("\\Z");
+      break;
+    default:
+      out.push_back(c);
+    }
+  }
+  out.push_back('\'');
+}
+
+// every '?' is a placeholder,and the text ends before the first unbound one
+static std::string reference_bind(std::string_view sql,
+                                  const std::vector<std::string_view> &args) {
+  std::string out;
+  size_t bound = 0;
+  for (char c : sql) {
+    if (c == '?') {
+      if (bound == args.size()) {
+        break;
+      }
+      reference_escape(args[bound++], out);
+    } else {
+      out.push_back(c);
+    }
+  }
+  return out;
+}
+
+// The input is the sql template followed by the arguments,separated by 0xff
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *Data, size_t Size) {
+  static worst_case_timer timer("bind_test");
+  std::string_view input(reinterpret_cast<const char *>(Data), Size);
+
+  std::vector<std::string_view> pieces;
+  while (true) {
+    const auto pos = input.find('\xff');
+    pieces.push_back(input.substr(0, pos));
+    if (pos == input.npos) {
+      break;
+    }
+    input.remove_prefix(pos + 1);
+  }
+  const auto sql = pieces.front();
+  const std::vector<std::string_view> args(pieces.begin() + 1, pieces.end());
+  size_t placeholder_count = 0;
+  for (char c : sql) {
+    placeholder_count += (c == '?');
+  }
+
+  // the vectorized scan agrees with a byte by byte one at every alignment
+  for (size_t offset = 0; offset < std::min<size_t>(Size, 32); offset++) {
+    const auto *data = reinterpret_cast<const char *>(Data) + offset;
+    size_t expected = 0;
+    while (expected < Size - offset &&
+           !mariadb::utility::needs_escape(
+               static_cast<unsigned char>(data[expected]))) {
+      expected++;
+    }
+    if (mariadb::utility::find_escape(data, Size - offset) != expected) {
+      std::abort();
+    }
+  }
+
+  timer.run(Size, [&] {
+    mariadb::explicit_statement stmt(get_connection(), std::string(sql));
+    bool overflowed = false;
+    try {
+      for (size_t i = 0; i < args.size(); i++) {
+        // both ways of binding a string
+        if (i % 2 == 0) {
+          stmt.append_string_argument(args[i].data(), args[i].size());
+        } else {
+          stmt << std::string(args[i]);
+        }
+      }
+    } catch (const mariadb::exceptions::more_prepare_arguments &) {
+      overflowed = true;
+    }
+    if (overflowed != (args.size() > placeholder_count)) {
+      std::abort();
+    }
+    if (!overflowed && stmt.bound_sql() != reference_bind(sql, args)) {
+      std::abort();
+    }
+  });
+  return 0;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+
+// Tracks the slowest input of a fuzz target relative to its size. Inputs
+// taking longer than a fixed overhead plus a linear budget per byte abort
+// the target,so a superlinear blowup found by the fuzzer is reported like
+// a crash instead of only slowing the run down. The budget is set by
+// MARIADB_FUZZ_BASE_NS and MARIADB_FUZZ_NS_PER_BYTE,0 disables it.
+class worst_case_timer {
+public:
+  explicit worst_case_timer(const char *name) noexcept
+      : _name(name), _base_ns(_env("MARIADB_FUZZ_BASE_NS", 20000000)),
+        _ns_per_byte(_env("MARIADB_FUZZ_NS_PER_BYTE", 1000)) {}
+
+  ~worst_case_timer() {
+    std::fprintf(stderr,
+                 "%s: worst case %lld ns for %zu bytes,%lld ns per byte for "
+                 "%zu bytes\n",
+                 _name, _worst_ns, _worst_size, _worst_ns_per_byte,
+                 _worst_ns_per_byte_size);
+  }
+
+  template <typename Function> void run(size_t size, Function &&f) {
+    const auto start = std::chrono::steady_clock::now();
+    f();
+    const long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+    if (ns > _worst_ns) {
+      _worst_ns = ns;
+      _worst_size = size;
+    }
+    if (size != 0 && ns / static_cast<long long>(size) > _worst_ns_per_byte) {
+      _worst_ns_per_byte = ns / static_cast<long long>(size);
+      _worst_ns_per_byte_size = size;
+    }
+    if (_ns_per_byte != 0 &&
+        ns > _base_ns + _ns_per_byte * static_cast<long long>(size)) {
+      std::fprintf(stderr, "%s: %lld ns for %zu bytes exceeds the budget\n",
+                   _name, ns, size);
+      std::abort();
+    }
+  }
+
+private:
+  static long long _env(const char *name, long long default_value) noexcept {
+    const char *value = std::getenv(name);
+    return value ? std::atoll(value) : default_value;
+  }
+
+  const char *_name;
+  long long _base_ns;
+  long long _ns_per_byte;
+  long long _worst_ns{0};
+  size_t _worst_size{0};
+  long long _worst_ns_per_byte{0};
+  size_t _worst_ns_per_byte_size{0};
+};
@@ -0,0 +1,144 @@
+/*!
+ * \file numeric_test.cpp
+ *
+ * \brief parses numeric column text without a server and compares the
+ * results with a reference parser and with the text written for arguments
+ * \date 2026-10-18
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <string>
+
+#include "../hdr/mariadb_modern_cpp.hpp"
+#include "fuzz_timing.hpp"
+
+// digits with an optional '-',without overflow
+template <typename Integer>
+static std::optional<Integer> reference_parse(const char *data, size_t size) {
+  bool negative = false;
+  size_t i = 0;
+  if (std::is_signed_v<Integer> && size > 0 && data[0] == '-') {
+    negative = true;
+    i = 1;
+  }
+  if (i == size) {
+    return {};
+  }
+  Integer value = 0;
+  for (; i < size; i++) {
+    if (data[i] < '0' || data[i] > '9') {
+      return {};
+    }
+    const auto digit = static_cast<Integer>(data[i] - '0');
+    if (negative) {
+      if (value < (std::numeric_limits<Integer>::min() + digit) / 10) {
+        return {};
+      }
+      value = static_cast<Integer>(value * 10 - digit);
+    } else {
+      if (value > (std::numeric_limits<Integer>::max() - digit) / 10) {
+        return {};
+      }
+      value = static_cast<Integer>(value * 10 + digit);
+    }
+  }
+  return value;
+}
+
+template <typename Integer> static void check_integer(const char *data,
+                                                      size_t size) {
+  MYSQL_FIELD field{};
+  field.type = MYSQL_TYPE_LONGLONG;
+  if (std::is_unsigned_v<Integer>) {
+    field.flags = UNSIGNED_FLAG;
+  }
+  Integer value{};
+  const auto status =
+      mariadb::type_converter<Integer>::from_sql(data, size, field, value);
+  const auto expected = reference_parse<Integer>(data, size);
+  if ((status == mariadb::conversion_status::ok) != expected.has_value() ||
+      (expected && *expected != value)) {
+    std::abort();
+  }
+}
+
+// an argument written by sql_writer reads back as the same value
+template <typename Value>
+static void check_round_trip(const Value &value, enum_field_types type) {
+  std::string text;
+  mariadb::sql_writer writer(nullptr, text);
+  mariadb::type_converter<Value>::to_sql(writer, value);
+  MYSQL_FIELD field{};
+  field.type = type;
+  Value parsed{};
+  if (mariadb::type_converter<Value>::from_sql(text.data(), text.size(), field,
+                                               parsed) !=
+          mariadb::conversion_status::ok ||
+      !(parsed == value)) {
+    std::abort();
+  }
+}
+
+// values of DECIMAL(30,25) and other scales beyond max_digits
+static void check_high_scales() {
+  static const char *const texts[] = {
+      "0.0000000000000000000000000", "-0.0000000000000000000000001",
+      "0.00000000000000000000000000000000000001",
+      "-12345678901234567.8"};
+  for (const char *text : texts) {
+    MYSQL_FIELD field{};
+    field.type = MYSQL_TYPE_NEWDECIMAL;
+    mariadb::decimal dec;
+    if (mariadb::type_converter<mariadb::decimal>::from_sql(
+            text, std::strlen(text), field, dec) !=
+            mariadb::conversion_status::ok ||
+        dec.to_string() != text) {
+      std::abort();
+    }
+    check_round_trip(dec, MYSQL_TYPE_NEWDECIMAL);
+  }
+  for (unsigned scale = 0; scale <= mariadb::decimal::max_scale; scale++) {
+    check_round_trip(mariadb::decimal(-999999999999999999, scale),
+                     MYSQL_TYPE_NEWDECIMAL);
+  }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *Data, size_t Size) {
+  static worst_case_timer timer("numeric_test");
+  static const bool high_scales_checked = (check_high_scales(), true);
+  (void)high_scales_checked;
+  const auto data = reinterpret_cast<const char *>(Data);
+
+  timer.run(Size, [&] {
+    check_integer<int64_t>(data, Size);
+    check_integer<uint64_t>(data, Size);
+
+    MYSQL_FIELD field{};
+    field.type = MYSQL_TYPE_NEWDECIMAL;
+    mariadb::decimal dec;
+    if (mariadb::type_converter<mariadb::decimal>::from_sql(data, Size, field,
+                                                            dec) ==
+        mariadb::conversion_status::ok) {
+      check_round_trip(dec, MYSQL_TYPE_NEWDECIMAL);
+    }
+
+    field.type = MYSQL_TYPE_DOUBLE;
+    double d{};
+    if (mariadb::type_converter<double>::from_sql(data, Size, field, d) ==
+            mariadb::conversion_status::ok &&
+        std::isfinite(d)) {
+      check_round_trip(d, MYSQL_TYPE_DOUBLE);
+    }
+    if (Size >= sizeof(double)) {
+      std::memcpy(&d, data, sizeof(d));
+      if (std::isfinite(d)) {
+        check_round_trip(d, MYSQL_TYPE_DOUBLE);
+      }
+    }
+  });
+  return 0;
+}
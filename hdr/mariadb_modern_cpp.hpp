@@ -14,16 +14,33 @@
 #include <cctype>
 #include <chrono>
 #include <cstddef>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <functional>
 #include <memory>
+#include <memory_resource>
 #include <mutex>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include "mariadb_modern_cpp/admission_controller.hpp"
+#include "mariadb_modern_cpp/connection_handle.hpp"
 #include "mariadb_modern_cpp/errors.hpp"
+#include "mariadb_modern_cpp/prepared_statement.hpp"
+#include "mariadb_modern_cpp/query_watchdog.hpp"
+#include "mariadb_modern_cpp/result.hpp"
+#include "mariadb_modern_cpp/slow_statement_hook.hpp"
+#include "mariadb_modern_cpp/statement_stats.hpp"
+#include "mariadb_modern_cpp/type_converter.hpp"
+#include "mariadb_modern_cpp/type_traits.hpp"
+#include "mariadb_modern_cpp/types.hpp"
 #include "mariadb_modern_cpp/utility/function_traits.hpp"
 
 namespace mariadb {
@@ -38,80 +55,186 @@ struct mariadb_config {
   std::chrono::seconds connect_timeout{10};
   std::chrono::seconds read_timeout{120};
   std::chrono::seconds write_timeout{10};
+  // required by bulk_loader
+  bool local_infile{false};
+  // set in one SET SESSION statement after connecting and after
+  // database::reset(),e.g. {"time_zone","'+00:00'"},values are sql
+  std::vector<std::pair<std::string, std::string>> session_variables;
+  // prepared after connecting and after database::reset(),see
+  // database::cached_statement()
+  std::vector<std::string> warm_statements;
 };
 
-template <typename Test, template <typename...> class Ref>
-struct is_specialization_of : std::false_type {};
-
-template <template <typename...> class Ref, typename... Args>
-struct is_specialization_of<Ref<Args...>, Ref> : std::true_type {};
-
-template <typename Type>
-struct is_mariadb_value
-    : public std::integral_constant<
-          bool, std::is_floating_point<Type>::value ||
-                    std::is_integral<Type>::value ||
-                    std::is_same<std::string, Type>::value> {};
-
-template <typename Type, typename Allocator>
-struct is_mariadb_value<std::vector<Type, Allocator>>
-    : public std::integral_constant<bool,
-                                    std::is_floating_point<Type>::value ||
-                                        std::is_integral<Type>::value ||
-                                        std::is_same<std::byte, Type>::value> {
-};
+enum class arena_reset { per_row, per_result_set };
 
-template <typename OptionalT>
-struct is_mariadb_value<std::optional<OptionalT>>
-    : public std::integral_constant<bool, is_mariadb_value<OptionalT>::value> {
-};
+constexpr unsigned long default_cursor_prefetch_rows = 1000;
 
-template <typename T>
-struct is_mariadb_value<std::unique_ptr<T>>
-    : public std::integral_constant<bool, is_mariadb_value<T>::value> {};
+namespace detail {
+struct pipeline_access;
+struct snapshot_access;
+struct buffered_access;
+}
 
-class statement_binder {
+// the statement is executed by the destructor if it wasn't used,so the
+// destructor can throw
+struct implicit_execution {
+  static constexpr bool execute_on_destruction = true;
+};
+// the statement only runs when executed or extracted,and the destructor
+// doesn't throw
+struct explicit_execution {
+  static constexpr bool execute_on_destruction = false;
+};
 
-public:
-  // statement_binder is not copyable
-  statement_binder() = delete;
-  statement_binder(const statement_binder &other) = delete;
-  statement_binder &operator=(const statement_binder &) = delete;
+template <typename Policy> class basic_statement_binder {
+  friend struct detail::pipeline_access;
+  friend struct detail::snapshot_access;
+  friend struct detail::buffered_access;
 
-  void execute() {
-    used(true);
+public:
+  // basic_statement_binder is not copyable
+  basic_statement_binder() = delete;
+  basic_statement_binder(const basic_statement_binder &other) = delete;
+  basic_statement_binder &operator=(const basic_statement_binder &) = delete;
+
+  basic_statement_binder(basic_statement_binder &&other) noexcept
+      : _db(other._db), _full_sql(std::move(other._full_sql)),
+        execution_started(other.execution_started), _digest(other._digest),
+        _cursor_prefetch_rows(other._cursor_prefetch_rows),
+        _timeout(other._timeout), _watchdog(other._watchdog),
+        _admission(other._admission),
+        _admission_priority(other._admission_priority),
+        _arena(std::move(other._arena)) {
+    const auto offset =
+        static_cast<size_t>(other._unprepared_sql_part.data() -
+                            other._sql.data());
+    const auto size = other._unprepared_sql_part.size();
+    _sql = std::move(other._sql);
+    _unprepared_sql_part = std::string_view(_sql).substr(offset, size);
+    // the moved-from statement must not execute
+    other.execution_started = true;
+  }
 
-    if (!_unprepared_sql_part.empty()) {
-      throw exceptions::lack_prepare_arguments(
-          "lacks some arguments to prepare sql",
-          std::string(_unprepared_sql_part.data(),
-                      _unprepared_sql_part.size()));
+  // Executes the statement,returning its error instead of throwing it
+  result<void> try_execute() {
+    const bool timed = statement_stats::enabled();
+    const auto start = timed ? std::chrono::steady_clock::now()
+                             : std::chrono::steady_clock::time_point{};
+    auto res = _run();
+    _watch.disarm();
+    if (timed) {
+      _record(start, 0, !res, true, _timed_out(res));
     }
+    return res;
+  }
+
+  // Gives each execution `timeout` to complete. The server aborts the
+  // statement after it by max_statement_time,and with a watchdog the query
+  // is also killed by KILL QUERY once the deadline passes on the client.
+  // Either way the statement fails with error_kind::deadline_exceeded and
+  // the connection stays usable.
+  basic_statement_binder &deadline(std::chrono::milliseconds timeout) {
+    _timeout = timeout;
+    _watchdog = nullptr;
+    return *this;
+  }
+  basic_statement_binder &deadline(std::chrono::milliseconds timeout,
+                                   query_watchdog &watchdog) {
+    _timeout = timeout;
+    _watchdog = &watchdog;
+    return *this;
+  }
+
+  // Each execution waits for a slot of `controller` first,and fails with
+  // error_kind::overloaded if it's rejected. The slot is held while the
+  // query runs,not while its rows are extracted. The wait counts against
+  // the deadline().
+  basic_statement_binder &admission(
+      admission_controller &controller,
+      admission_priority priority = admission_priority::normal) {
+    _admission = &controller;
+    _admission_priority = priority;
+    return *this;
+  }
 
-    if (mysql_real_query(_db.get(), _full_sql.c_str(), _full_sql.size()) != 0) {
-      throw mariadb_exception(_db.get(), _full_sql);
+  // the digest of the sql template,see sql_digest()
+  uint64_t digest() const noexcept {
+    if (_digest == 0) {
+      _digest = sql_digest(_sql);
     }
-    _reset();
+    return _digest;
+  }
+
+  // binds the arguments in order
+  template <typename... Arguments>
+  basic_statement_binder &bind(Arguments &&... arguments) {
+    return (*this << ... << std::forward<Arguments>(arguments));
+  }
+
+  void execute() { _check(try_execute()); }
+
+  // Extracts like `operator>>`,returning the errors of the statement and of
+  // the column conversions instead of throwing them. Exceptions thrown by a
+  // callback are passed through.
+  template <typename Result>
+  typename std::enable_if<is_mariadb_value<Result>::value, result<void>>::type
+  try_extract(Result &value) {
+    return this->_try_extract([&value, this] { _get_col_from_row(0, value); },
+                              true);
+  }
+
+  template <typename... Types>
+  result<void> try_extract(std::tuple<Types...> &&values) {
+    return this->_try_extract(
+        [&values, this]() {
+          tuple_iterate<std::tuple<Types...>>::iterate(values, *this);
+        },
+        true);
+  }
+
+  template <typename Function>
+  typename std::enable_if<!is_mariadb_value<Function>::value,
+                          result<void>>::type
+  try_extract(Function &&func) {
+    typedef utility::function_traits<Function> traits;
+
+    return this->_try_extract(
+        [&func, this]() { binder<traits::arity>::run(*this, func); }, false);
   }
 
   std::string sql() { return _sql; }
 
+  // the sql text with the arguments bound so far,up to the next placeholder
+  std::string_view bound_sql() const noexcept { return _full_sql; }
+
   void used(bool state) {
-    if (state) {
-      while (mysql_more_results(_db.get())) {
-        auto reset_set = mysql_use_result(_db.get());
-        if (!reset_set) {
-          throw mariadb_exception(_db.get());
-        }
-        mysql_free_result(reset_set);
-      }
+    if (state && !_discard_results()) {
+      throw mariadb_exception(_db.get());
     }
     execution_started = state;
   }
   bool used() const noexcept { return execution_started; }
 
+  // Decodes std::pmr strings and vectors passed to `operator>>` callbacks
+  // into a monotonic arena owned by this statement,which is released after
+  // each row or after each result set. The values must not outlive that.
+  void use_arena(arena_reset reset = arena_reset::per_row,
+                 size_t initial_size = 64 * 1024) {
+    _arena = std::make_unique<arena>(initial_size);
+    _arena->reset = reset;
+  }
+
+  // Extractions executing the statement read its rows through a read-only
+  // server side cursor,`prefetch_rows` rows per round trip. Unlike a
+  // streamed result,other statements can run on the connection while the
+  // rows are extracted,e.g. from the callback. The statement is prepared by
+  // the binary protocol,so it must be a single SELECT.
+  void use_cursor(unsigned long prefetch_rows = default_cursor_prefetch_rows) {
+    _cursor_prefetch_rows = std::max<unsigned long>(prefetch_rows, 1);
+  }
+
 private:
-  std::shared_ptr<MYSQL> _db;
+  connection_handle _db;
   std::string _sql;
   std::string_view _unprepared_sql_part;
   std::string _full_sql;
@@ -121,6 +244,184 @@ private:
   unsigned int field_count{};
 
   bool execution_started = false;
+  mutable uint64_t _digest{0};
+  // 0 unless use_cursor() is called
+  unsigned long _cursor_prefetch_rows{0};
+  // 0 unless deadline() is called
+  std::chrono::milliseconds _timeout{0};
+  query_watchdog *_watchdog{};
+  // null unless admission() is called
+  admission_controller *_admission{};
+  admission_priority _admission_priority{admission_priority::normal};
+  // armed while the query of the statement runs
+  query_watchdog::guard _watch;
+
+  // the first failed conversion of the current row
+  struct column_error {
+    error_kind kind;
+    unsigned int column;
+    unsigned int detail;
+  };
+  std::optional<column_error> _column_error;
+
+  struct arena {
+    explicit arena(size_t initial_size)
+        : buffer(std::make_unique<std::byte[]>(initial_size)),
+          resource(buffer.get(), initial_size) {}
+    std::unique_ptr<std::byte[]> buffer;
+    std::pmr::monotonic_buffer_resource resource;
+    arena_reset reset;
+  };
+  std::unique_ptr<arena> _arena;
+
+  // callback arguments using polymorphic allocators are allocated from the
+  // arena if there is one
+  template <typename Value> Value _make_value() {
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+    if constexpr (std::uses_allocator_v<Value, allocator_type>) {
+      if (_arena) {
+        return Value(allocator_type(&_arena->resource));
+      }
+    } else if constexpr (is_specialization_of<Value, std::optional>::value) {
+      if constexpr (std::uses_allocator_v<typename Value::value_type,
+                                          allocator_type>) {
+        if (_arena) {
+          return Value(std::in_place, allocator_type(&_arena->resource));
+        }
+      }
+    }
+    return Value{};
+  }
+
+  result<void> _run() {
+    execution_started = true;
+    if (!_discard_results()) {
+      return error::from(_db.get());
+    }
+    if (!_unprepared_sql_part.empty()) {
+      return error(error_kind::lack_prepare_arguments);
+    }
+    // the wait for admission counts against the deadline
+    auto timeout = _timeout;
+    admission_controller::permit permit;
+    if (_admission) {
+      const auto queued = std::chrono::steady_clock::now();
+      auto admitted = _admission->admit(_admission_priority, _timeout);
+      if (!admitted) {
+        return admitted.error();
+      }
+      permit = std::move(*admitted);
+      if (_timeout.count() > 0) {
+        timeout -= std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - queued);
+        if (timeout.count() <= 0) {
+          permit.release(true);
+          return error(error_kind::deadline_exceeded);
+        }
+      }
+    }
+    const auto slow_ns = detail::slow_statement_hook::threshold_ns();
+    const auto start = slow_ns > 0 ? std::chrono::steady_clock::now()
+                                   : std::chrono::steady_clock::time_point{};
+    int res{};
+    if (_timeout.count() > 0) {
+      const auto sql = _deadline_sql(timeout);
+      _arm_watchdog(timeout);
+      res = mysql_real_query(_db.get(), sql.c_str(), sql.size());
+    } else {
+      res = mysql_real_query(_db.get(), _full_sql.c_str(), _full_sql.size());
+    }
+    if (slow_ns > 0) {
+      _report_slow(start, slow_ns, res != 0);
+    }
+    if (res != 0) {
+      _watch.disarm();
+      const auto e = _error_of(error::from(_db.get()));
+      permit.release(e.kind() == error_kind::deadline_exceeded);
+      return e;
+    }
+    permit.release();
+    _reset();
+    return {};
+  }
+
+  // hands the statement to the slow statement sink if it took `slow_ns` or
+  // longer,before the bound sql is cleared. `stmt` is set when it ran as a
+  // prepared statement
+  void _report_slow(std::chrono::steady_clock::time_point start,
+                    int64_t slow_ns, bool failed,
+                    MYSQL_STMT *stmt = nullptr) const noexcept {
+    const auto latency = std::chrono::steady_clock::now() - start;
+    if (std::chrono::duration_cast<std::chrono::nanoseconds>(latency)
+            .count() < slow_ns) {
+      return;
+    }
+    uint64_t affected_rows{};
+    if (!failed && stmt) {
+      affected_rows = mysql_stmt_field_count(stmt) == 0
+                          ? mysql_stmt_affected_rows(stmt)
+                          : 0;
+    } else if (!failed) {
+      affected_rows = mysql_field_count(_db.get()) == 0
+                          ? mysql_affected_rows(_db.get())
+                          : 0;
+    }
+    detail::slow_statement_hook::report(digest(), _full_sql, latency,
+                                        affected_rows, failed);
+  }
+
+  // MariaDB aborts the statement after max_statement_time seconds
+  std::string _deadline_sql(std::chrono::milliseconds timeout) const {
+    char prefix[64];
+    const auto n = std::snprintf(
+        prefix, sizeof(prefix), "SET STATEMENT max_statement_time=%.3f FOR ",
+        static_cast<double>(timeout.count()) / 1000);
+    std::string sql;
+    sql.reserve(static_cast<size_t>(n) + _full_sql.size());
+    sql.append(prefix, static_cast<size_t>(n));
+    sql.append(_full_sql);
+    return sql;
+  }
+
+  void _arm_watchdog(std::chrono::milliseconds timeout) {
+    if (_watchdog) {
+      _watch = _watchdog->arm(std::chrono::steady_clock::now() + timeout,
+                              mysql_thread_id(_db.get()));
+    }
+  }
+
+  // reports the errors of aborted or killed queries as deadline_exceeded
+  // when there is a deadline
+  error _error_of(const error &e) const noexcept {
+    // ER_QUERY_INTERRUPTED and ER_STATEMENT_TIMEOUT
+    if (_timeout.count() > 0 && (e.code() == 1317 || e.code() == 1969)) {
+      return e.with_kind(error_kind::deadline_exceeded);
+    }
+    return e;
+  }
+
+  static bool _timed_out(const result<void> &res) noexcept {
+    return !res && res.error().kind() == error_kind::deadline_exceeded;
+  }
+
+  void _record(std::chrono::steady_clock::time_point start, uint64_t rows,
+               bool failed, bool executed,
+               bool timed_out = false) const noexcept {
+    statement_stats::record(digest(), _sql,
+                            std::chrono::steady_clock::now() - start, rows,
+                            failed, executed, timed_out);
+  }
+
+  bool _discard_results() noexcept {
+    while (mysql_more_results(_db.get())) {
+      auto reset_set = mysql_use_result(_db.get());
+      if (!reset_set) {
+        return false;
+      }
+      mysql_free_result(reset_set);
+    }
+    return true;
+  }
 
   void _reset() {
     _unprepared_sql_part = _sql;
@@ -140,9 +441,43 @@ private:
     }
   }
 
-  void _extract(std::function<void(void)> call_back) {
-    if (!used()) {
-      execute();
+  // the sql attached to the exception of an error
+  [[noreturn]] void _raise(const error &e) const {
+    switch (e.kind()) {
+    case error_kind::server:
+    case error_kind::deadline_exceeded:
+      e.raise(_full_sql);
+    case error_kind::lack_prepare_arguments:
+      e.raise(std::string(_unprepared_sql_part.data(),
+                          _unprepared_sql_part.size()));
+    default:
+      e.raise(_sql);
+    }
+  }
+
+  void _check(const result<void> &res) const {
+    if (!res) {
+      _raise(res.error());
+    }
+  }
+
+  result<void> _try_extract(const std::function<void(void)> &call_back,
+                            bool single_row) {
+    _column_error.reset();
+    if (_cursor_prefetch_rows != 0 && !used()) {
+      return _try_extract_by_cursor(call_back, single_row);
+    }
+    const bool timed = statement_stats::enabled();
+    const auto start = timed ? std::chrono::steady_clock::now()
+                             : std::chrono::steady_clock::time_point{};
+    const bool executed = !used();
+    if (executed) {
+      if (auto res = _run(); !res) {
+        if (timed) {
+          _record(start, 0, true, true, _timed_out(res));
+        }
+        return res;
+      }
     }
 
     auto result_set = std::shared_ptr<MYSQL_RES>(
@@ -150,242 +485,277 @@ private:
           row = {};
           fields = {};
           field_count = {};
+          if (_arena) {
+            _arena->resource.release();
+          }
           mysql_free_result(ptr);
         });
 
+    // the query can be killed while its rows are read
+    _watch.disarm();
+    const bool failed = !result_set && mysql_errno(_db.get()) != 0;
+    const auto store_error =
+        failed ? std::optional<error>(_error_of(error::from(_db.get())))
+               : std::nullopt;
+    if (timed) {
+      _record(start, result_set ? mysql_num_rows(result_set.get()) : 0,
+              failed, executed,
+              store_error &&
+                  store_error->kind() == error_kind::deadline_exceeded);
+    }
+    if (store_error) {
+      return *store_error;
+    }
     if (!result_set) {
-      throw exceptions::no_result_sets(
-          "no result sets to extract: exactly 1 result set expected", sql());
+      return error(error_kind::no_result_sets);
     }
 
     const auto row_num = mysql_num_rows(result_set.get());
+    if (single_row && row_num == 0) {
+      return error(error_kind::no_rows);
+    } else if (single_row && row_num > 1) {
+      return error(error_kind::more_rows);
+    }
     for (size_t i = 0; i < row_num; i++) {
       row = mysql_fetch_row(result_set.get());
       lengths = mysql_fetch_lengths(result_set.get());
       fields = mysql_fetch_fields(result_set.get());
       field_count = mysql_field_count(_db.get());
       call_back();
+      if (_column_error) {
+        return error(_column_error->kind, _column_error->column,
+                     _column_error->detail);
+      }
+      if (_arena && _arena->reset == arena_reset::per_row) {
+        _arena->resource.release();
+      }
     }
 
     if (mysql_more_results(_db.get())) {
-      throw exceptions::more_result_sets("no all result sets extracted", sql());
+      return error(error_kind::more_result_sets);
     }
+    return {};
   }
 
-  void _extract_single_value(std::function<void(void)> call_back) {
-    if (!used()) {
-      execute();
+  // Columns are fetched as text into buffers which grow when a value is
+  // truncated,so the rows are decoded by the same type_converter as
+  // mysql_store_result rows.
+  result<void> _try_extract_by_cursor(
+      const std::function<void(void)> &call_back, bool single_row) {
+    const bool timed = statement_stats::enabled();
+    const auto start = timed ? std::chrono::steady_clock::now()
+                             : std::chrono::steady_clock::time_point{};
+    execution_started = true;
+    if (!_discard_results()) {
+      return error::from(_db.get());
+    }
+    if (!_unprepared_sql_part.empty()) {
+      return error(error_kind::lack_prepare_arguments);
     }
 
-    auto result_set = std::shared_ptr<MYSQL_RES>(
-        mysql_store_result(_db.get()), [this](MYSQL_RES * ptr) noexcept {
+    std::vector<MYSQL_FIELD> field_storage;
+    std::vector<std::string> values;
+    std::vector<char *> row_storage;
+    std::vector<unsigned long> length_storage;
+    std::vector<my_bool> nulls;
+    std::vector<MYSQL_BIND> binds;
+    auto stmt = std::shared_ptr<MYSQL_STMT>(
+        mysql_stmt_init(_db.get()), [this](MYSQL_STMT *ptr) noexcept {
           row = {};
+          lengths = {};
           fields = {};
           field_count = {};
-          mysql_free_result(ptr);
+          if (_arena) {
+            _arena->resource.release();
+          }
+          if (ptr) {
+            mysql_stmt_close(ptr);
+          }
         });
-
-    if (!result_set) {
-      throw exceptions::no_result_sets(
-          "no result sets to extract: exactly 1 result set expected", sql());
+    if (!stmt) {
+      return error::from(_db.get());
     }
-
-    const auto row_num = mysql_num_rows(result_set.get());
-    if (row_num == 0) {
-      throw exceptions::no_rows("no rows to extract: exactly 1 row expected",
-                                sql());
-    } else if (row_num > 1) {
-      throw exceptions::more_rows("not all rows extracted", sql());
+    const unsigned long cursor_type = CURSOR_TYPE_READ_ONLY;
+    const auto sql =
+        _timeout.count() > 0 ? _deadline_sql(_timeout) : _full_sql;
+    bool failed =
+        mysql_stmt_prepare(stmt.get(), sql.c_str(), sql.size()) != 0 ||
+        mysql_stmt_attr_set(stmt.get(), STMT_ATTR_CURSOR_TYPE, &cursor_type) !=
+            0 ||
+        mysql_stmt_attr_set(stmt.get(), STMT_ATTR_PREFETCH_ROWS,
+                            &_cursor_prefetch_rows) != 0;
+    if (!failed) {
+      // only the execution is watched and reported as slow,the connection
+      // is free during fetches
+      const auto slow_ns = detail::slow_statement_hook::threshold_ns();
+      const auto execute_start =
+          slow_ns > 0 ? std::chrono::steady_clock::now()
+                      : std::chrono::steady_clock::time_point{};
+      _arm_watchdog(_timeout);
+      failed = mysql_stmt_execute(stmt.get()) != 0;
+      _watch.disarm();
+      if (slow_ns > 0) {
+        _report_slow(execute_start, slow_ns, failed, stmt.get());
+      }
     }
-
-    row = mysql_fetch_row(result_set.get());
-    lengths = mysql_fetch_lengths(result_set.get());
-    fields = mysql_fetch_fields(result_set.get());
-    field_count = mysql_field_count(_db.get());
-    call_back();
-
-    if (mysql_more_results(_db.get())) {
-      throw exceptions::more_result_sets("no all result sets extracted", sql());
+    if (failed) {
+      const auto e = _error_of(error::from(stmt.get()));
+      if (timed) {
+        _record(start, 0, true, true,
+                e.kind() == error_kind::deadline_exceeded);
+      }
+      return e;
     }
-  }
-
-  friend statement_binder &append_string_argument(statement_binder &db,
-                                                  const char *str, size_t size);
-
-  template <typename Result>
-  typename std::enable_if<is_mariadb_value<Result>::value, void>::type
-  _get_col_from_row(unsigned int idx, Result &val) {
-
-    if (idx >= field_count) {
-      throw exceptions::out_of_row_range(
-          std::string("try to access column ") + std::to_string(idx) +
-              " ,exceeds column count " + std::to_string(field_count),
-          sql());
+    if (timed) {
+      _record(start, 0, false, true);
     }
 
-    const auto field_type = fields[idx].type;
-
-    if constexpr (is_specialization_of<Result, std::optional>::value) {
-      if (!row[idx]) {
-        val.reset();
-        return;
-      } else {
-        typename Result::value_type real_value;
-        _get_col_from_row(idx, real_value);
-        val = std::move(real_value);
-        return;
-      }
-    } else if constexpr (is_specialization_of<Result, std::unique_ptr>::value) {
-      if (!row[idx]) {
-        val.reset();
-        return;
-      } else {
-        typename Result::element_type real_value;
-        _get_col_from_row(idx, real_value);
-        val = std::make_unique<typename Result::element_type>(
-            std::move(real_value));
-        return;
-      }
-    } else {
-      if (!row[idx]) {
-        throw exceptions::can_not_hold_null(
-            std::string("column ") + std::to_string(idx) +
-                " can be NULL,can't be stored in "
-                "argument type,try std::optional",
-            sql());
-      }
+    auto metadata = std::unique_ptr<MYSQL_RES, void (*)(MYSQL_RES *)>(
+        mysql_stmt_result_metadata(stmt.get()),
+        [](MYSQL_RES *ptr) noexcept { mysql_free_result(ptr); });
+    if (!metadata) {
+      _reset();
+      return error(error_kind::no_result_sets);
+    }
+    const auto column_count = mysql_num_fields(metadata.get());
+    const auto *metadata_fields = mysql_fetch_fields(metadata.get());
+    field_storage.assign(metadata_fields, metadata_fields + column_count);
+    values.resize(column_count);
+    row_storage.assign(column_count, nullptr);
+    length_storage.assign(column_count, 0);
+    nulls.assign(column_count, 0);
+    binds.assign(column_count, MYSQL_BIND{});
+    for (unsigned int i = 0; i < column_count; i++) {
+      values[i].resize(
+          std::clamp<unsigned long>(field_storage[i].length, 1, 256));
     }
 
-    switch (field_type) {
-    case MYSQL_TYPE_TINY:
-    case MYSQL_TYPE_SHORT:
-    case MYSQL_TYPE_LONG:
-    case MYSQL_TYPE_LONGLONG:
-    case MYSQL_TYPE_INT24:
-      if constexpr (std::is_integral_v<Result>) {
-
-        errno = 0;
-        if (fields[idx].flags & UNSIGNED_FLAG) {
-          val = static_cast<Result>(::strtoull(row[idx], nullptr, 10));
-        } else {
-          val = static_cast<Result>(::strtoll(row[idx], nullptr, 10));
+    bool rebind = true;
+    uint64_t row_num = 0;
+    while (true) {
+      if (rebind) {
+        for (unsigned int i = 0; i < column_count; i++) {
+          binds[i].buffer_type = MYSQL_TYPE_STRING;
+          binds[i].buffer = values[i].data();
+          binds[i].buffer_length = static_cast<unsigned long>(values[i].size());
+          binds[i].length = &length_storage[i];
+          binds[i].is_null = &nulls[i];
         }
-        if (errno != 0) {
-          throw exceptions::column_conversion(
-              std::string("converting column ") + std::to_string(idx) +
-                  " to integer failed",
-              sql());
+        if (mysql_stmt_bind_result(stmt.get(), binds.data()) != 0) {
+          return error::from(stmt.get());
         }
-        return;
-      } else {
-        break;
+        rebind = false;
       }
-    case MYSQL_TYPE_DECIMAL:
-    case MYSQL_TYPE_NEWDECIMAL:
-    case MYSQL_TYPE_FLOAT:
-    case MYSQL_TYPE_DOUBLE:
-      if constexpr (std::is_floating_point_v<Result>) {
-        errno = 0;
-        val = ::strtold(row[idx], nullptr);
-        if (errno != 0) {
-          throw exceptions::column_conversion(
-              std::string("converting column ") + std::to_string(idx) +
-                  " to floating point failed",
-              sql());
-        }
-        return;
-      } else {
+      const auto status = mysql_stmt_fetch(stmt.get());
+      if (status == MYSQL_NO_DATA) {
         break;
       }
-    case MYSQL_TYPE_VARCHAR:
-    case MYSQL_TYPE_VAR_STRING:
-    case MYSQL_TYPE_STRING:
-      if constexpr (std::is_same_v<Result, std::string>) {
-        val = std::string(row[idx], lengths[idx]);
-        return;
-      } else {
-        break;
+      if (status != 0 && status != MYSQL_DATA_TRUNCATED) {
+        return error::from(stmt.get());
       }
-
-    case MYSQL_TYPE_TINY_BLOB:
-    case MYSQL_TYPE_MEDIUM_BLOB:
-    case MYSQL_TYPE_LONG_BLOB:
-    case MYSQL_TYPE_BLOB:
-      if constexpr (std::is_same_v<Result, std::string>) {
-        /*
-       To distinguish between binary and nonbinary data for string data types,
-       check whether the charsetnr value is 63. If so, the character set is
-       binary, which indicates binary rather than nonbinary data. This enables
-       you to distinguish BINARY from CHAR, VARBINARY from VARCHAR, and the BLOB
-       types from the TEXT types.
-
-       see https://dev.mysql.com/doc/refman/8.0/en/c-api-data-structures.html
-       */
-
-        if (fields[idx].charsetnr != 63) {
-          val = std::string(row[idx], lengths[idx]);
-          return;
+      if (single_row && row_num == 1) {
+        return error(error_kind::more_rows);
+      }
+      for (unsigned int i = 0; i < column_count; i++) {
+        if (nulls[i]) {
+          row_storage[i] = nullptr;
+          continue;
         }
-      } else if constexpr (is_specialization_of<Result, std::vector>::value) {
-        if (lengths[idx] % sizeof(typename Result::value_type) != 0) {
-          throw exceptions::bad_alignment(
-              std::string("column ") + std::to_string(idx) + " type " +
-                  std::to_string(field_type) + " can't be stored in argument",
-              sql());
+        if (length_storage[i] > values[i].size()) {
+          values[i].resize(length_storage[i]);
+          MYSQL_BIND bind = binds[i];
+          bind.buffer = values[i].data();
+          bind.buffer_length = length_storage[i];
+          if (mysql_stmt_fetch_column(stmt.get(), &bind, i, 0) != 0) {
+            return error::from(stmt.get());
+          }
+          rebind = true;
         }
-        val.resize(lengths[idx] / sizeof(typename Result::value_type));
-        memcpy(val.data(), row[idx], lengths[idx]);
-        return;
+        row_storage[i] = values[i].data();
       }
-      break;
-    default:
-      break;
+      row = row_storage.data();
+      lengths = length_storage.data();
+      fields = field_storage.data();
+      field_count = column_count;
+      call_back();
+      row_num++;
+      if (_column_error) {
+        return error(_column_error->kind, _column_error->column,
+                     _column_error->detail);
+      }
+      if (_arena && _arena->reset == arena_reset::per_row) {
+        _arena->resource.release();
+      }
+    }
+    _reset();
+    if (timed) {
+      statement_stats::record(digest(), _sql, {}, row_num, false, false);
+    }
+    if (single_row && row_num == 0) {
+      return error(error_kind::no_rows);
     }
+    return {};
+  }
 
-    throw exceptions::unsupported_column_type(
-        std::string("column ") + std::to_string(idx) + " type " +
-            std::to_string(field_type) + " is not supported",
-        sql());
+  // records the error and returns false if the column can't be converted
+  template <typename Result>
+  typename std::enable_if<is_mariadb_value<Result>::value, bool>::type
+  _get_col_from_row(unsigned int idx, Result &val) {
+
+    if (idx >= field_count) {
+      _column_error = column_error{error_kind::out_of_row_range, idx,
+                                   field_count};
+      return false;
+    }
+
+    const auto status = type_converter<Result>::from_sql(
+        row[idx], lengths[idx], fields[idx], val);
+    if (status != conversion_status::ok) {
+      _column_error = column_error{detail::conversion_error_kind(status), idx,
+                                   static_cast<unsigned int>(fields[idx].type)};
+      return false;
+    }
+    return true;
   }
 
 public:
-  statement_binder(std::shared_ptr<MYSQL> db, std::string sql)
+  basic_statement_binder(connection_handle db, std::string sql)
       : _db(db), _sql(std::move(sql)), _unprepared_sql_part(_sql) {
     _reset();
   }
 
-  ~statement_binder() noexcept(false) {
-    if (!used() && std::uncaught_exceptions() == 0) {
-      execute();
-      used(true);
+  ~basic_statement_binder() noexcept(!Policy::execute_on_destruction) {
+    if constexpr (Policy::execute_on_destruction) {
+      if (!used() && std::uncaught_exceptions() == 0) {
+        execute();
+        used(true);
+      }
     }
   }
 
   template <typename Result>
   typename std::enable_if<is_mariadb_value<Result>::value, void>::type
   operator>>(Result &value) {
-    this->_extract_single_value(
-        [&value, this] { _get_col_from_row(0, value); });
+    _check(try_extract(value));
   }
 
   template <typename Tuple, int Element = 0,
             bool Last = (std::tuple_size<Tuple>::value == Element)>
   struct tuple_iterate {
-    static void iterate(Tuple &t, statement_binder &db) {
-      db._get_col_from_row(Element, std::get<Element>(t));
-      tuple_iterate<Tuple, Element + 1>::iterate(t, db);
+    static void iterate(Tuple &t, basic_statement_binder &db) {
+      if (db._get_col_from_row(Element, std::get<Element>(t))) {
+        tuple_iterate<Tuple, Element + 1>::iterate(t, db);
+      }
     }
   };
 
   template <typename Tuple, int Element>
   struct tuple_iterate<Tuple, Element, true> {
-    static void iterate(Tuple &, statement_binder &) {}
+    static void iterate(Tuple &, basic_statement_binder &) {}
   };
 
   template <typename... Types> void operator>>(std::tuple<Types...> &&values) {
-    this->_extract_single_value([&values, this]() {
-      tuple_iterate<std::tuple<Types...>>::iterate(values, *this);
-    });
+    _check(try_extract(std::move(values)));
   }
 
   template <std::size_t Count> class binder {
@@ -405,10 +775,14 @@ public:
     template <typename Function, typename... Values,
               std::size_t Boundary = Count>
     static typename std::enable_if<(sizeof...(Values) < Boundary), void>::type
-    run(statement_binder &db, Function &&function, Values &&... values) {
-      typename std::remove_cv<typename std::remove_reference<
-          nth_argument_type<Function, sizeof...(Values)>>::type>::type value{};
-      db._get_col_from_row(sizeof...(Values), value);
+    run(basic_statement_binder &db, Function &&function,
+        Values &&... values) {
+      using value_type = typename std::remove_cv<typename std::remove_reference<
+          nth_argument_type<Function, sizeof...(Values)>>::type>::type;
+      value_type value = db._make_value<value_type>();
+      if (!db._get_col_from_row(sizeof...(Values), value)) {
+        return;
+      }
 
       run<Function>(db, function, std::forward<Values>(values)...,
                     std::move(value));
@@ -417,7 +791,7 @@ public:
     template <typename Function, typename... Values,
               std::size_t Boundary = Count>
     static typename std::enable_if<(sizeof...(Values) == Boundary), void>::type
-    run(statement_binder &, Function &&function, Values &&... values) {
+    run(basic_statement_binder &, Function &&function, Values &&... values) {
       function(std::move(values)...);
     }
   };
@@ -425,15 +799,11 @@ public:
   template <typename Function>
   typename std::enable_if<!is_mariadb_value<Function>::value, void>::type
   operator>>(Function &&func) {
-    typedef utility::function_traits<Function> traits;
-
-    this->_extract(
-        [&func, this]() { binder<traits::arity>::run(*this, func); });
+    _check(try_extract(std::forward<Function>(func)));
   }
 
-  // Convert char* to string to trigger op<<(..., const std::string )
   template <std::size_t N>
-  inline statement_binder &operator<<(const char (&STR)[N]) {
+  inline basic_statement_binder &operator<<(const char (&STR)[N]) {
     return append_string_argument(STR, N - 1);
   }
 
@@ -442,75 +812,40 @@ public:
   typename std::enable_if<
       is_mariadb_value<typename std::remove_cv<
           typename std::remove_reference<Argument>::type>::type>::value,
-      statement_binder &>::type
+      basic_statement_binder &>::type
 
   operator<<(Argument &&val) {
     using raw_argument_type = typename std::remove_cv<
         typename std::remove_reference<Argument>::type>::type;
 
-    if constexpr (std::is_same_v<raw_argument_type, std::string>) {
-      return append_string_argument(val.c_str(), val.size());
-    } else if constexpr (is_specialization_of<raw_argument_type,
-                                              std::vector>::value) {
-      return append_string_argument(
-          val.data(),
-          val.size() * sizeof(typename raw_argument_type::value_type));
-    } else {
-
-      if (_unprepared_sql_part.empty()) {
-        throw exceptions::more_prepare_arguments(
-            "no extra arguments needed to prepare sql", _sql);
-      }
-
-      if constexpr (is_specialization_of<raw_argument_type,
-                                         std::optional>::value) {
-        if (val.has_value()) {
-          return (*this) << (*val);
-        } else {
-          _full_sql.append("NULL");
-        }
-      } else if constexpr (is_specialization_of<raw_argument_type,
-                                                std::unique_ptr>::value) {
-        if (val.get()) {
-          return (*this) << (*val);
-        } else {
-          _full_sql.append("NULL");
-        }
-      } else {
-        _full_sql.append(std::to_string(std::forward<Argument>(val)));
-      }
-
-      _unprepared_sql_part.remove_prefix(1);
-      _consume_prepared_sql_part();
-      return (*this);
+    if (_unprepared_sql_part.empty()) {
+      _raise(error(error_kind::more_prepare_arguments));
     }
+
+    sql_writer writer(_db.get(), _full_sql);
+    type_converter<raw_argument_type>::to_sql(writer, val);
+    _unprepared_sql_part.remove_prefix(1);
+    _consume_prepared_sql_part();
+    return (*this);
   }
 
-  statement_binder &append_string_argument(const void *str, size_t size) {
+  basic_statement_binder &append_string_argument(const void *str,
+                                                 size_t size) {
 
     if (_unprepared_sql_part.empty()) {
-      throw exceptions::more_prepare_arguments(
-          "no extra arguments needed to prepare sql", _sql);
+      _raise(error(error_kind::more_prepare_arguments));
     }
 
-    std::string escaped_str(size * 2 + 1, '\0');
-    auto const real_size = mysql_real_escape_string(
-        _db.get(), escaped_str.data(), static_cast<const char *>(str), size);
-    escaped_str.resize(real_size);
-
-    if (real_size == static_cast<unsigned long>(-1)) {
-      throw mariadb_exception(_db.get());
-    }
-
-    _full_sql.push_back('\'');
-    _full_sql.append(escaped_str.data(), escaped_str.size());
-    _full_sql.push_back('\'');
+    sql_writer(_db.get(), _full_sql).write_string(str, size);
     _unprepared_sql_part.remove_prefix(1);
     _consume_prepared_sql_part();
     return (*this);
   }
 };
 
+using statement_binder = basic_statement_binder<implicit_execution>;
+using explicit_statement = basic_statement_binder<explicit_execution>;
+
 class transaction_context final {
 public:
   // transaction_context is not copyable
@@ -518,31 +853,31 @@ public:
   transaction_context(const transaction_context &other) = delete;
   transaction_context &operator=(const transaction_context &) = delete;
 
-  transaction_context(std::shared_ptr<MYSQL> db)
-      : _db(db), _transaction_statment(db, "begin;") {
-    _transaction_statment.execute();
+  transaction_context(connection_handle db) : _db(db) {
+    statement_binder(_db, "begin;").execute();
   }
 
+  // commits,or rolls back when leaving the scope by an exception
   ~transaction_context() noexcept {
-    if (std::uncaught_exceptions()) {
-      _db.reset();
-      return;
+    if (std::uncaught_exceptions() == 0) {
+      try {
+        statement_binder(_db, "commit;").execute();
+        return;
+      } catch (...) {
+      }
     }
     try {
-      _transaction_statment.execute();
-      statement_binder(_db, "commit;").execute();
+      statement_binder(_db, "rollback;").execute();
     } catch (...) {
-      _db.reset();
     }
   }
 
-  statement_binder &operator<<(const std::string &sql) {
-    return _transaction_statment << sql;
+  statement_binder operator<<(const std::string &sql) {
+    return statement_binder(_db, sql);
   }
 
 private:
-  std::shared_ptr<MYSQL> _db;
-  statement_binder _transaction_statment;
+  connection_handle _db;
 };
 
 struct library_initer {
@@ -560,6 +895,13 @@ inline void init_thread() noexcept { thread_local thread_setting setting; }
 class database {
 protected:
   std::shared_ptr<MYSQL> _db;
+  mariadb_config _config;
+  std::string _session_sql;
+  std::vector<std::string> _warm_statements;
+  std::unordered_map<std::string, prepared_statement> _statement_cache;
+  std::unique_ptr<query_watchdog> _watchdog;
+  admission_controller *_admission{};
+  admission_priority _admission_priority{admission_priority::normal};
 
 public:
   // database is not copyable
@@ -567,7 +909,7 @@ public:
   database(const database &other) = delete;
   database &operator=(const database &) = delete;
 
-  database(const mariadb_config &config) : _db(nullptr) {
+  database(const mariadb_config &config) : _db(nullptr), _config(config) {
     init_library();
     init_thread();
     MYSQL *tmp = mysql_init(nullptr);
@@ -594,6 +936,13 @@ public:
     if (res != 0)
       throw mariadb_exception("MYSQL_OPT_WRITE_TIMEOUT failed");
 
+    if (config.local_infile) {
+      unsigned int enable = 1;
+      res = mysql_options(tmp, MYSQL_OPT_LOCAL_INFILE, &enable);
+      if (res != 0)
+        throw mariadb_exception("MYSQL_OPT_LOCAL_INFILE failed");
+    }
+
     {
       // mysql_real_connect is not thread safe,so we use mutex to protect
       static std::mutex connect_mtx;
@@ -609,19 +958,129 @@ public:
         throw exceptions::connection(_db.get());
       }
     }
+
+    for (const auto &[name, value] : config.session_variables) {
+      _session_sql.append(_session_sql.empty() ? "SET SESSION " : ",");
+      _session_sql.append(name);
+      _session_sql.push_back('=');
+      _session_sql.append(value);
+    }
+    _warm_statements = config.warm_statements;
+    _init_session();
+  }
+
+  ~database() { _clear_statement_cache(); }
+
+  // Clears the session state with mysql_reset_connection,which is cheaper than
+  // reconnecting,then applies the session variables of the config again.
+  void reset() {
+    _clear_statement_cache();
+    if (mysql_reset_connection(_db.get()) != 0) {
+      throw mariadb_exception(_db.get());
+    }
+    _init_session();
+  }
+
+  // Returns a statement prepared once per session and reused afterwards.
+  // It must be extracted or executed before being requested again.
+  prepared_statement &cached_statement(const std::string &sql) {
+    auto it = _statement_cache.find(sql);
+    auto &stmt =
+        it == _statement_cache.end() ? _cache_statement(sql) : it->second;
+    stmt.reuse();
+    return stmt;
   }
 
   statement_binder operator<<(const std::string &sql) {
-    return statement_binder(_db, sql);
+    statement_binder stmt(_db, sql);
+    if (_admission) {
+      stmt.admission(*_admission, _admission_priority);
+    }
+    return stmt;
+  }
+
+  // a statement which only runs when executed or extracted
+  explicit_statement statement(const std::string &sql) {
+    explicit_statement stmt(_db, sql);
+    if (_admission) {
+      stmt.admission(*_admission, _admission_priority);
+    }
+    return stmt;
+  }
+
+  // The statements created by operator<< and statement() are admitted by
+  // `controller`,see basic_statement_binder::admission. Pass nullptr to
+  // stop.
+  void use_admission(admission_controller *controller,
+                     admission_priority priority = admission_priority::normal) {
+    _admission = controller;
+    _admission_priority = priority;
+  }
+
+  prepared_statement prepare(const std::string &sql) {
+    return prepared_statement(_db, sql);
   }
 
   transaction_context get_transaction_context() {
     return transaction_context(_db);
   }
 
+  // A watchdog for statement deadlines,see basic_statement_binder::deadline.
+  // It kills queries from another connection to the same server,opened on
+  // the first kill.
+  query_watchdog &watchdog() {
+    if (!_watchdog) {
+      auto config = _config;
+      config.warm_statements.clear();
+      _watchdog = std::make_unique<query_watchdog>(
+          [config, side = std::shared_ptr<database>()](
+              unsigned long connection_id) mutable {
+            if (!side) {
+              side = std::make_shared<database>(config);
+            }
+            auto res =
+                side->statement("KILL QUERY " + std::to_string(connection_id))
+                    .try_execute();
+            // after a client error like CR_SERVER_LOST,the next kill
+            // reconnects
+            if (!res && res.error().code() >= CR_MIN_ERROR) {
+              side.reset();
+            }
+            res.value();
+          });
+    }
+    return *_watchdog;
+  }
+
+  // shares the ownership of the connection
   auto connection() const noexcept -> auto { return _db; }
+  connection_handle handle() const noexcept { return _db; }
 
   my_ulonglong insert_id() const noexcept { return mysql_insert_id(_db.get()); }
+
+private:
+  void _init_session() {
+    if (!_session_sql.empty()) {
+      statement_binder(_db, _session_sql).execute();
+    }
+    for (const auto &sql : _warm_statements) {
+      _cache_statement(sql);
+    }
+  }
+
+  prepared_statement &_cache_statement(const std::string &sql) {
+    auto &stmt = _statement_cache.try_emplace(sql, _db, sql).first->second;
+    // cached statements are only executed when requested
+    stmt.used(true);
+    return stmt;
+  }
+
+  void _clear_statement_cache() noexcept {
+    for (auto &[sql, stmt] : _statement_cache) {
+      stmt.used(true);
+    }
+    _statement_cache.clear();
+  }
 }; // namespace mariadb
 
 } // namespace mariadb
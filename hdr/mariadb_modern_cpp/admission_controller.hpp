@@ -0,0 +1,284 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+#include "result.hpp"
+
+namespace mariadb {
+
+// lower priorities are admitted first
+enum class admission_priority : unsigned char { critical, normal, batch };
+
+// why a statement was rejected,the detail of error_kind::overloaded
+enum class admission_rejection : unsigned char { queue_full, queue_timeout };
+
+struct admission_options {
+  size_t initial_limit{16};
+  size_t min_limit{1};
+  size_t max_limit{512};
+  // statements waiting at most,the others are rejected at once unless they
+  // displace a waiting statement of a lower priority
+  size_t max_queue{128};
+  // a statement waits at most this long,and at most for its deadline()
+  std::chrono::milliseconds queue_timeout{500};
+  // the limit shrinks while the recent latency exceeds the long term one by
+  // more than this factor
+  double tolerance{1.5};
+  // samples averaged into the long term latency
+  size_t long_window{600};
+  // the weight of each new limit
+  double smoothing{0.2};
+};
+
+struct admission_stats {
+  size_t limit{};
+  size_t in_flight{};
+  size_t queued{};
+  uint64_t admitted{};
+  uint64_t rejected_full{};
+  uint64_t rejected_timeout{};
+  std::chrono::nanoseconds short_latency{};
+  std::chrono::nanoseconds long_latency{};
+};
+
+// Limits the statements running at once on a server,usually shared by all
+// connections to it. The limit adapts to the latency of the statements: it
+// shrinks by the ratio of the long term to the recent latency once the
+// recent one grows beyond `tolerance`,and grows by its square root while
+// the latency is stable and the limit is used. Statements over the limit
+// wait in a queue by priority,and are rejected when it's full or their
+// wait times out,so the server isn't overrun during overload.
+class admission_controller {
+public:
+  using clock = std::chrono::steady_clock;
+
+  // a slot of the limit,released on destruction
+  class permit {
+  public:
+    permit() noexcept = default;
+    permit(const permit &) = delete;
+    permit &operator=(const permit &) = delete;
+    permit(permit &&other) noexcept
+        : _controller(other._controller), _start(other._start) {
+      other._controller = nullptr;
+    }
+    permit &operator=(permit &&other) noexcept {
+      if (this != &other) {
+        release();
+        _controller = other._controller;
+        _start = other._start;
+        other._controller = nullptr;
+      }
+      return *this;
+    }
+    ~permit() { release(); }
+
+    explicit operator bool() const noexcept { return _controller; }
+
+    // records the latency since admission,`dropped` for statements aborted
+    // by their deadline,which shrink the limit instead
+    void release(bool dropped = false) noexcept {
+      if (_controller) {
+        _controller->_release(clock::now() - _start, dropped);
+        _controller = nullptr;
+      }
+    }
+
+  private:
+    friend class admission_controller;
+    permit(admission_controller *controller, clock::time_point start) noexcept
+        : _controller(controller), _start(start) {}
+
+    admission_controller *_controller{};
+    clock::time_point _start;
+  };
+
+  explicit admission_controller(admission_options options = {})
+      : _options(options) {
+    _options.min_limit = std::max<size_t>(_options.min_limit, 1);
+    _options.max_limit = std::max(_options.max_limit, _options.min_limit);
+    _limit = static_cast<double>(std::clamp(
+        _options.initial_limit, _options.min_limit, _options.max_limit));
+  }
+
+  admission_controller(const admission_controller &) = delete;
+  admission_controller &operator=(const admission_controller &) = delete;
+
+  // Waits for a slot,at most queue_timeout and `max_wait` unless it's 0.
+  // Fails with error_kind::overloaded.
+  result<permit> admit(admission_priority priority = admission_priority::normal,
+                       std::chrono::milliseconds max_wait = {}) {
+    std::unique_lock lk(_mtx);
+    if (_queued == 0 && _in_flight < _slots()) {
+      return _admit();
+    }
+    if (_queued >= _options.max_queue && !_displace(priority)) {
+      _rejected_full++;
+      return _rejection(admission_rejection::queue_full);
+    }
+
+    auto wait = _options.queue_timeout;
+    if (max_wait.count() > 0) {
+      wait = std::min(wait, max_wait);
+    }
+    const auto deadline = clock::now() + wait;
+    waiter w;
+    auto &queue = _queues[static_cast<size_t>(priority)];
+    queue.push_back(&w);
+    _queued++;
+    while (w.state == waiter::waiting) {
+      if (w.cv.wait_until(lk, deadline) == std::cv_status::timeout) {
+        break;
+      }
+    }
+    switch (w.state) {
+    case waiter::granted:
+      return permit(this, clock::now());
+    case waiter::displaced:
+      return _rejection(admission_rejection::queue_full);
+    case waiter::waiting:
+      break;
+    }
+    queue.erase(std::find(queue.begin(), queue.end(), &w));
+    _queued--;
+    _rejected_timeout++;
+    return _rejection(admission_rejection::queue_timeout);
+  }
+
+  admission_stats stats() const {
+    std::lock_guard lk(_mtx);
+    admission_stats s;
+    s.limit = _slots();
+    s.in_flight = _in_flight;
+    s.queued = _queued;
+    s.admitted = _admitted;
+    s.rejected_full = _rejected_full;
+    s.rejected_timeout = _rejected_timeout;
+    s.short_latency = std::chrono::nanoseconds(
+        static_cast<std::chrono::nanoseconds::rep>(_short_ns));
+    s.long_latency = std::chrono::nanoseconds(
+        static_cast<std::chrono::nanoseconds::rep>(_long_ns));
+    return s;
+  }
+
+private:
+  static constexpr size_t priority_count = 3;
+  // recent latency is averaged over about this many samples
+  static constexpr double short_window = 10;
+  // the limit shrinks by this factor for each dropped statement
+  static constexpr double drop_backoff = 0.9;
+
+  struct waiter {
+    enum state_type { waiting, granted, displaced };
+    std::condition_variable cv;
+    state_type state{waiting};
+  };
+
+  size_t _slots() const noexcept { return static_cast<size_t>(_limit); }
+
+  permit _admit() {
+    _in_flight++;
+    _admitted++;
+    return permit(this, clock::now());
+  }
+
+  static error _rejection(admission_rejection reason) noexcept {
+    return error(error_kind::overloaded, 0,
+                 static_cast<unsigned int>(reason));
+  }
+
+  // rejects the newest waiter of the lowest priority below `priority`
+  bool _displace(admission_priority priority) {
+    for (size_t p = priority_count; p-- > static_cast<size_t>(priority) + 1;) {
+      auto &queue = _queues[p];
+      if (!queue.empty()) {
+        auto *w = queue.back();
+        queue.pop_back();
+        _queued--;
+        _rejected_full++;
+        w->state = waiter::displaced;
+        w->cv.notify_one();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void _release(clock::duration latency, bool dropped) noexcept {
+    std::lock_guard lk(_mtx);
+    const auto in_flight = _in_flight--;
+    if (dropped) {
+      _limit = std::max(static_cast<double>(_options.min_limit),
+                        _limit * drop_backoff);
+    } else {
+      _update_limit(
+          static_cast<double>(
+              std::chrono::duration_cast<std::chrono::nanoseconds>(latency)
+                  .count()),
+          in_flight);
+    }
+    _grant();
+  }
+
+  void _update_limit(double sample_ns, size_t in_flight) noexcept {
+    sample_ns = std::max(sample_ns, 1.0);
+    if (_long_ns == 0) {
+      _short_ns = _long_ns = sample_ns;
+    }
+    _short_ns += (sample_ns - _short_ns) * (2 / (short_window + 1));
+    _long_ns += (sample_ns - _long_ns) /
+                static_cast<double>(std::max<size_t>(_options.long_window, 1));
+    // after a lasting drop of the latency the long term average catches up
+    // faster
+    if (_long_ns > _short_ns * 2) {
+      _long_ns *= 0.95;
+    }
+    const double gradient =
+        std::clamp(_options.tolerance * _long_ns / _short_ns, 0.5, 1.0);
+    // the limit only grows while it's used
+    if (gradient == 1.0 && static_cast<double>(in_flight) < _limit / 2) {
+      return;
+    }
+    const double target = _limit * gradient + std::sqrt(_limit);
+    _limit = std::clamp(_limit * (1 - _options.smoothing) +
+                            target * _options.smoothing,
+                        static_cast<double>(_options.min_limit),
+                        static_cast<double>(_options.max_limit));
+  }
+
+  // hands free slots to the waiters,by priority and then in order
+  void _grant() noexcept {
+    for (auto &queue : _queues) {
+      while (!queue.empty() && _in_flight < _slots()) {
+        auto *w = queue.front();
+        queue.pop_front();
+        _queued--;
+        _in_flight++;
+        _admitted++;
+        w->state = waiter::granted;
+        w->cv.notify_one();
+      }
+    }
+  }
+
+  admission_options _options;
+  mutable std::mutex _mtx;
+  double _limit;
+  size_t _in_flight{};
+  size_t _queued{};
+  std::deque<waiter *> _queues[priority_count];
+  uint64_t _admitted{};
+  uint64_t _rejected_full{};
+  uint64_t _rejected_timeout{};
+  // exponential moving averages of the latency
+  double _short_ns{};
+  double _long_ns{};
+};
+
+} // namespace mariadb
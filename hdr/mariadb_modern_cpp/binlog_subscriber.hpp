@@ -0,0 +1,480 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "../mariadb_modern_cpp.hpp"
+
+#if __has_include(<mariadb/mariadb_rpl.h>)
+#include <mariadb/mariadb_rpl.h>
+#else
+#error binlog_subscriber needs mariadb_rpl.h of MariaDB Connector/C 3.3 or later
+#endif
+
+namespace mariadb {
+
+enum class change_type { inserted, updated, deleted };
+
+// A row image of a row event. Its values are kept as text like the rows of
+// the text protocol,so they are converted by the same type_converters.
+class binlog_row {
+public:
+  unsigned int size() const noexcept {
+    return static_cast<unsigned int>(_types.size());
+  }
+  bool empty() const noexcept { return _types.empty(); }
+
+  bool is_null(unsigned int idx) const noexcept {
+    return idx < size() && _nulls[idx];
+  }
+
+  // converts column `idx` and throws the exceptions of operator>> on failure
+  template <typename Result> Result get(unsigned int idx) const {
+    Result val{};
+    if (idx >= size()) {
+      error(error_kind::out_of_row_range, idx, size()).raise();
+    }
+    MYSQL_FIELD field{};
+    field.type = _types[idx];
+    const auto begin = idx == 0 ? 0 : _ends[idx - 1];
+    const auto status = type_converter<Result>::from_sql(
+        _nulls[idx] ? nullptr : _data.data() + begin, _ends[idx] - begin,
+        field, val);
+    if (status != conversion_status::ok) {
+      detail::throw_conversion_error(status, idx, field, {});
+    }
+    return val;
+  }
+
+  // the leading columns converted to `Types`
+  template <typename... Types> std::tuple<Types...> as() const {
+    return _as<Types...>(std::index_sequence_for<Types...>());
+  }
+
+private:
+  friend class binlog_subscriber;
+
+  template <typename... Types, size_t... Index>
+  std::tuple<Types...> _as(std::index_sequence<Index...>) const {
+    return std::tuple<Types...>(get<Types>(Index)...);
+  }
+
+  void _append(enum_field_types type, const char *data, size_t size) {
+    _data.append(data, size);
+    _ends.push_back(_data.size());
+    _types.push_back(type);
+    _nulls.push_back(0);
+  }
+
+  void _append_null(enum_field_types type) {
+    _ends.push_back(_data.size());
+    _types.push_back(type);
+    _nulls.push_back(1);
+  }
+
+  std::string _data;
+  std::vector<size_t> _ends;
+  std::vector<enum_field_types> _types;
+  std::vector<char> _nulls;
+};
+
+struct binlog_change {
+  change_type type;
+  std::string database;
+  std::string table;
+  // empty for inserts
+  binlog_row before;
+  // empty for deletes
+  binlog_row after;
+};
+
+struct binlog_batch {
+  // the row changes of whole transactions,in commit order
+  std::vector<binlog_change> changes;
+  // the GTID position after the last transaction of the batch
+  std::string position;
+};
+
+struct binlog_subscriber_options {
+  // must differ from the server ids of the server and its replicas
+  uint32_t server_id{};
+  // "database.table",all tables if empty
+  std::vector<std::string> tables;
+  // a GTID position like @@gtid_binlog_pos,the current one if empty
+  std::string start_position;
+  // changes delivered at once,a transaction is never split
+  size_t batch_size{512};
+  // the longest a committed change waits for its batch to fill
+  std::chrono::milliseconds max_delay{100};
+};
+
+// Reads the row events of the binary log as a replica would and delivers
+// the changes of committed transactions. The server needs binlog_format=ROW
+// and the user the REPLICATION SLAVE privilege.
+class binlog_subscriber {
+public:
+  binlog_subscriber(const mariadb_config &config,
+                    binlog_subscriber_options options)
+      : _db(config), _options(std::move(options)),
+        _tables(_options.tables.begin(), _options.tables.end()),
+        _rpl(nullptr, mariadb_rpl_close) {
+    if (_options.server_id == 0) {
+      throw mariadb_exception("binlog_subscriber needs a server_id");
+    }
+    auto start = _options.start_position;
+    if (start.empty()) {
+      _db << "select @@global.gtid_binlog_pos" >> start;
+    }
+    _parse_position(start);
+
+    // GTID events are only sent with the capability,and heartbeats while
+    // there are no events let batches be flushed in time
+    const auto heartbeat =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            _options.max_delay)
+            .count();
+    _db << "set @mariadb_slave_capability=4,@slave_connect_state=?,"
+           "@slave_gtid_strict_mode=0,@slave_gtid_ignore_duplicates=0,"
+           "@master_heartbeat_period=?"
+        << start << static_cast<int64_t>(heartbeat);
+
+    MYSQL *mysql = _db.handle().get();
+    _rpl.reset(mariadb_rpl_init(mysql));
+    if (!_rpl) {
+      throw mariadb_exception(mysql);
+    }
+    // an empty file name starts from @slave_connect_state
+    if (mariadb_rpl_optionsv(_rpl.get(), MARIADB_RPL_SERVER_ID,
+                             static_cast<unsigned int>(_options.server_id)) !=
+            0 ||
+        mariadb_rpl_optionsv(_rpl.get(), MARIADB_RPL_FILENAME, "",
+                             static_cast<size_t>(0)) != 0 ||
+        mariadb_rpl_optionsv(_rpl.get(), MARIADB_RPL_START,
+                             static_cast<unsigned long>(4)) != 0 ||
+        mariadb_rpl_open(_rpl.get()) != 0) {
+      throw mariadb_exception(mysql);
+    }
+  }
+
+  binlog_subscriber(const binlog_subscriber &) = delete;
+  binlog_subscriber &operator=(const binlog_subscriber &) = delete;
+
+  // Delivers batches until `callback` returns false or stop() is called.
+  // A batch ends at a transaction boundary,so passing its position as
+  // start_position resumes right after it.
+  void run(const std::function<bool(binlog_batch &)> &callback) {
+    while (!_stop.load(std::memory_order_relaxed)) {
+      auto event = _fetch();
+      switch (event->event_type) {
+      case GTID_EVENT:
+        _begin(*event);
+        break;
+      case TABLE_MAP_EVENT:
+        _map_table(std::move(event));
+        break;
+      case XID_EVENT:
+        _commit();
+        break;
+      case QUERY_EVENT:
+        if (_standalone || _is_commit(event->event.query.statement)) {
+          _commit();
+        }
+        break;
+      case HEARTBEAT_LOG_EVENT:
+        break;
+      default:
+        if (_is_rows_event(event->event_type)) {
+          _decode_rows(*event);
+          // STMT_END_F,each statement maps its tables again
+          if (event->event.rows.flags & 1) {
+            _table_maps.clear();
+          }
+        }
+        continue;
+      }
+      if (_should_flush()) {
+        auto batch = std::move(_batch);
+        _batch = {};
+        if (!callback(batch)) {
+          return;
+        }
+      }
+    }
+  }
+
+  // makes run() return after the event it waits for,heartbeats arrive at
+  // least every max_delay
+  void stop() noexcept { _stop.store(true, std::memory_order_relaxed); }
+
+  // the GTID position after the last committed transaction read
+  std::string position() const { return _position(); }
+
+private:
+  using event_ptr =
+      std::unique_ptr<MARIADB_RPL_EVENT, void (*)(MARIADB_RPL_EVENT *)>;
+
+  struct table_map {
+    event_ptr event;
+    bool selected;
+  };
+
+  struct gtid {
+    uint32_t server_id;
+    uint64_t sequence_nr;
+  };
+
+  event_ptr _fetch() {
+    event_ptr event(mariadb_rpl_fetch(_rpl.get(), nullptr),
+                    mariadb_free_rpl_event);
+    if (!event) {
+      throw mariadb_exception(_db.handle().get());
+    }
+    return event;
+  }
+
+  static bool _is_rows_event(mariadb_rpl_event type) noexcept {
+    switch (type) {
+    case WRITE_ROWS_EVENT_V1:
+    case UPDATE_ROWS_EVENT_V1:
+    case DELETE_ROWS_EVENT_V1:
+    case WRITE_ROWS_EVENT:
+    case UPDATE_ROWS_EVENT:
+    case DELETE_ROWS_EVENT:
+    case WRITE_ROWS_COMPRESSED_EVENT:
+    case UPDATE_ROWS_COMPRESSED_EVENT:
+    case DELETE_ROWS_COMPRESSED_EVENT:
+    case WRITE_ROWS_COMPRESSED_EVENT_V1:
+    case UPDATE_ROWS_COMPRESSED_EVENT_V1:
+    case DELETE_ROWS_COMPRESSED_EVENT_V1:
+      return true;
+    default:
+      return false;
+    }
+  }
+
+  static bool _is_commit(const MARIADB_STRING &statement) noexcept {
+    const std::string_view text(statement.str, statement.length);
+    return text.size() == 6 &&
+           std::equal(text.begin(), text.end(), "COMMIT",
+                      [](char a, char b) { return (a & ~0x20) == b; });
+  }
+
+  void _begin(const MARIADB_RPL_EVENT &event) {
+    _transaction.clear();
+    _table_maps.clear();
+    _current = {event.server_id, event.event.gtid.sequence_nr};
+    _current_domain = event.event.gtid.domain_id;
+    // FL_STANDALONE,a statement without a transaction,e.g. DDL
+    _standalone = (event.event.gtid.flags & 1) != 0;
+  }
+
+  void _commit() {
+    _positions[_current_domain] = _current;
+    _standalone = false;
+    if (_transaction.empty()) {
+      return;
+    }
+    if (_batch.changes.empty()) {
+      _batch_started = std::chrono::steady_clock::now();
+    }
+    for (auto &change : _transaction) {
+      _batch.changes.push_back(std::move(change));
+    }
+    _transaction.clear();
+    _batch.position = _position();
+  }
+
+  bool _should_flush() const {
+    return !_batch.changes.empty() &&
+           (_batch.changes.size() >= _options.batch_size ||
+            std::chrono::steady_clock::now() - _batch_started >=
+                _options.max_delay);
+  }
+
+  void _map_table(event_ptr event) {
+    const auto &map = event->event.table_map;
+    std::string name(map.database.str, map.database.length);
+    name.push_back('.');
+    name.append(map.table.str, map.table.length);
+    const bool selected = _tables.empty() || _tables.count(name) != 0;
+    const auto table_id = map.table_id;
+    _table_maps.insert_or_assign(table_id,
+                                 table_map{std::move(event), selected});
+  }
+
+  void _decode_rows(MARIADB_RPL_EVENT &event) {
+    auto it = _table_maps.find(event.event.rows.table_id);
+    if (it == _table_maps.end() || !it->second.selected) {
+      return;
+    }
+    auto &map = it->second.event->event.table_map;
+    const auto *row =
+        mariadb_rpl_extract_rows(_rpl.get(), it->second.event.get(), &event);
+    while (row) {
+      binlog_change change;
+      change.database.assign(map.database.str, map.database.length);
+      change.table.assign(map.table.str, map.table.length);
+      switch (event.event.rows.type) {
+      case WRITE_ROWS:
+        change.type = change_type::inserted;
+        _decode_row(*row, change.after);
+        break;
+      case DELETE_ROWS:
+        change.type = change_type::deleted;
+        _decode_row(*row, change.before);
+        break;
+      default:
+        // the images before and after an update come in pairs
+        change.type = change_type::updated;
+        _decode_row(*row, change.before);
+        row = row->next;
+        if (!row) {
+          throw mariadb_exception("update row event without after image");
+        }
+        _decode_row(*row, change.after);
+        break;
+      }
+      _transaction.push_back(std::move(change));
+      row = row->next;
+    }
+  }
+
+  static enum_field_types _text_type(enum_field_types type) noexcept {
+    switch (type) {
+    case MYSQL_TYPE_TIMESTAMP2:
+      return MYSQL_TYPE_TIMESTAMP;
+    case MYSQL_TYPE_DATETIME2:
+      return MYSQL_TYPE_DATETIME;
+    case MYSQL_TYPE_TIME2:
+      return MYSQL_TYPE_TIME;
+    default:
+      return type;
+    }
+  }
+
+  // writes each value as the text protocol would
+  static void _decode_row(const MARIADB_RPL_ROW &row, binlog_row &out) {
+    char buffer[64];
+    for (uint32_t i = 0; i < row.column_count; i++) {
+      const auto &value = row.columns[i];
+      const auto type = _text_type(value.field_type);
+      if (value.is_null) {
+        out._append_null(type);
+        continue;
+      }
+      switch (type) {
+      case MYSQL_TYPE_TINY:
+      case MYSQL_TYPE_SHORT:
+      case MYSQL_TYPE_INT24:
+      case MYSQL_TYPE_LONG:
+      case MYSQL_TYPE_LONGLONG:
+      case MYSQL_TYPE_YEAR: {
+        // BIGINT UNSIGNED values above INT64_MAX wrap around,and read back
+        // as the same uint64_t
+        const auto res =
+            std::to_chars(buffer, buffer + sizeof(buffer), value.val.ll);
+        out._append(type, buffer, static_cast<size_t>(res.ptr - buffer));
+        break;
+      }
+      case MYSQL_TYPE_FLOAT:
+      case MYSQL_TYPE_DOUBLE: {
+        const double d = type == MYSQL_TYPE_FLOAT
+                             ? static_cast<double>(value.val.f)
+                             : value.val.d;
+        const auto n = std::snprintf(buffer, sizeof(buffer), "%.*g",
+                                     type == MYSQL_TYPE_FLOAT ? 9 : 17, d);
+        out._append(type, buffer, static_cast<size_t>(n));
+        break;
+      }
+      case MYSQL_TYPE_DATE:
+      case MYSQL_TYPE_NEWDATE:
+      case MYSQL_TYPE_DATETIME:
+      case MYSQL_TYPE_TIMESTAMP:
+      case MYSQL_TYPE_TIME:
+        out._append(type, buffer,
+                    detail::format_mysql_time(value.val.tm, buffer));
+        break;
+      default:
+        out._append(type, value.val.str.str, value.val.str.length);
+        break;
+      }
+    }
+  }
+
+  // "domain-server-sequence" for each domain
+  void _parse_position(std::string_view position) {
+    while (!position.empty()) {
+      const auto end = std::min(position.find(','), position.size());
+      auto text = position.substr(0, end);
+      position.remove_prefix(std::min(end + 1, position.size()));
+      while (!text.empty() && text.front() == ' ') {
+        text.remove_prefix(1);
+      }
+      uint32_t domain{};
+      gtid id{};
+      const auto *first = text.data();
+      const auto *last = text.data() + text.size();
+      auto res = std::from_chars(first, last, domain);
+      bool ok = res.ec == std::errc() && res.ptr != last && *res.ptr == '-';
+      if (ok) {
+        res = std::from_chars(res.ptr + 1, last, id.server_id);
+        ok = res.ec == std::errc() && res.ptr != last && *res.ptr == '-';
+      }
+      if (ok) {
+        res = std::from_chars(res.ptr + 1, last, id.sequence_nr);
+        ok = res.ec == std::errc() && res.ptr == last;
+      }
+      if (!ok) {
+        throw mariadb_exception("invalid GTID position " +
+                                std::string(text));
+      }
+      _positions[domain] = id;
+    }
+  }
+
+  std::string _position() const {
+    std::string position;
+    for (const auto &[domain, id] : _positions) {
+      if (!position.empty()) {
+        position.push_back(',');
+      }
+      position.append(std::to_string(domain));
+      position.push_back('-');
+      position.append(std::to_string(id.server_id));
+      position.push_back('-');
+      position.append(std::to_string(id.sequence_nr));
+    }
+    return position;
+  }
+
+  database _db;
+  binlog_subscriber_options _options;
+  std::unordered_set<std::string> _tables;
+  std::unique_ptr<MARIADB_RPL, void (*)(MARIADB_RPL *)> _rpl;
+  // the tables mapped by the current statement
+  std::unordered_map<uint64_t, table_map> _table_maps;
+  std::map<uint32_t, gtid> _positions;
+  uint32_t _current_domain{};
+  gtid _current{};
+  bool _standalone{false};
+  std::vector<binlog_change> _transaction;
+  binlog_batch _batch;
+  std::chrono::steady_clock::time_point _batch_started;
+  std::atomic<bool> _stop{false};
+};
+
+} // namespace mariadb
@@ -0,0 +1,404 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "../mariadb_modern_cpp.hpp"
+
+namespace mariadb {
+
+constexpr size_t default_result_memory_budget = 64 * 1024 * 1024;
+
+// The memory held by all results buffered by extract_buffered() in the
+// process. Rows which don't fit spill to disk,like the rows beyond the
+// budget of their statement.
+class result_memory {
+public:
+  static void set_budget(size_t bytes) noexcept {
+    _budget().store(bytes, std::memory_order_relaxed);
+  }
+  static size_t budget() noexcept {
+    return _budget().load(std::memory_order_relaxed);
+  }
+  static size_t used() noexcept {
+    return _used().load(std::memory_order_relaxed);
+  }
+
+  // reserves `bytes` if they fit the budget
+  static bool try_reserve(size_t bytes) noexcept {
+    auto &used = _used();
+    auto current = used.load(std::memory_order_relaxed);
+    do {
+      const auto limit = budget();
+      if (current > limit || bytes > limit - current) {
+        return false;
+      }
+    } while (!used.compare_exchange_weak(current, current + bytes,
+                                         std::memory_order_relaxed));
+    return true;
+  }
+  static void release(size_t bytes) noexcept {
+    _used().fetch_sub(bytes, std::memory_order_relaxed);
+  }
+
+private:
+  static std::atomic<size_t> &_budget() noexcept {
+    static std::atomic<size_t> budget{SIZE_MAX};
+    return budget;
+  }
+  static std::atomic<size_t> &_used() noexcept {
+    static std::atomic<size_t> used{0};
+    return used;
+  }
+};
+
+// what extract_buffered() did with the rows
+struct buffered_result_info {
+  uint64_t rows{};
+  uint64_t spilled_rows{};
+  uint64_t spilled_bytes{};
+};
+
+namespace detail {
+
+/*
+  Rows are kept in a compact format,every column is a LEB128 varint of its
+  length plus one,0 for NULL,followed by the value. They are appended to
+  memory blocks while the budgets allow it,and the remaining rows to an
+  unlinked temporary file,which is memory mapped to be read back. A row is
+  never split across blocks.
+*/
+class spill_buffer {
+public:
+  spill_buffer(size_t memory_budget, unsigned int column_count)
+      : _memory_budget(memory_budget), _column_count(column_count) {}
+
+  spill_buffer(const spill_buffer &) = delete;
+  spill_buffer &operator=(const spill_buffer &) = delete;
+
+  ~spill_buffer() {
+    result_memory::release(_reserved);
+    if (_map) {
+      ::munmap(_map, _spilled_bytes);
+    }
+    if (_file) {
+      std::fclose(_file);
+    }
+  }
+
+  void add_row(MYSQL_ROW row, const unsigned long *lengths) {
+    _encoded.clear();
+    for (unsigned int i = 0; i < _column_count; i++) {
+      if (!row[i]) {
+        _put_varint(0);
+        continue;
+      }
+      _put_varint(uint64_t(lengths[i]) + 1);
+      _encoded.append(row[i], lengths[i]);
+    }
+    _rows++;
+
+    if (!_file) {
+      auto *block = _blocks.empty() ? nullptr : &_blocks.back();
+      if (!block || block->capacity - block->size < _encoded.size()) {
+        block = _new_block(_encoded.size());
+      }
+      if (block) {
+        std::memcpy(block->data.get() + block->size, _encoded.data(),
+                    _encoded.size());
+        block->size += _encoded.size();
+        return;
+      }
+      _open_file();
+    }
+    if (std::fwrite(_encoded.data(), 1, _encoded.size(), _file) !=
+        _encoded.size()) {
+      _fail();
+    }
+    _spilled_rows++;
+    _spilled_bytes += _encoded.size();
+  }
+
+  // maps the spilled rows,call once all rows are added
+  void finish() {
+    if (!_file || _spilled_bytes == 0) {
+      return;
+    }
+    if (std::fflush(_file) != 0) {
+      _fail();
+    }
+    void *map = ::mmap(nullptr, _spilled_bytes, PROT_READ, MAP_PRIVATE,
+                       ::fileno(_file), 0);
+    if (map == MAP_FAILED) {
+      _fail();
+    }
+    _map = static_cast<char *>(map);
+    ::madvise(_map, _spilled_bytes, MADV_SEQUENTIAL);
+  }
+
+  // decodes the next row into `row` and `lengths`,pointing into the buffer
+  bool next(char **row, unsigned long *lengths) noexcept {
+    const char *pos{};
+    while (true) {
+      if (_read_block < _blocks.size()) {
+        auto &block = _blocks[_read_block];
+        if (_read_offset < block.size) {
+          pos = block.data.get() + _read_offset;
+          break;
+        }
+        _read_block++;
+        _read_offset = 0;
+        continue;
+      }
+      if (_map && _read_offset < _spilled_bytes) {
+        pos = _map + _read_offset;
+        break;
+      }
+      return false;
+    }
+    const char *start = pos;
+    for (unsigned int i = 0; i < _column_count; i++) {
+      const auto length = _get_varint(pos);
+      if (length == 0) {
+        row[i] = nullptr;
+        lengths[i] = 0;
+        continue;
+      }
+      row[i] = const_cast<char *>(pos);
+      lengths[i] = static_cast<unsigned long>(length - 1);
+      pos += length - 1;
+    }
+    _read_offset += static_cast<size_t>(pos - start);
+    return true;
+  }
+
+  buffered_result_info info() const noexcept {
+    return {_rows, _spilled_rows, _spilled_bytes};
+  }
+
+private:
+  static constexpr size_t block_size = 64 * 1024;
+
+  struct block {
+    std::unique_ptr<char[]> data;
+    size_t size;
+    size_t capacity;
+  };
+
+  // returns nullptr if a block for `row_size` doesn't fit the budgets
+  block *_new_block(size_t row_size) {
+    if (_reserved >= _memory_budget) {
+      return nullptr;
+    }
+    const auto process_budget = result_memory::budget();
+    const auto process_used = result_memory::used();
+    const auto process_left =
+        process_budget > process_used ? process_budget - process_used : 0;
+    const auto capacity = std::max(
+        row_size,
+        std::min({block_size, _memory_budget - _reserved, process_left}));
+    if (capacity > _memory_budget - _reserved ||
+        !result_memory::try_reserve(capacity)) {
+      return nullptr;
+    }
+    _reserved += capacity;
+    _blocks.push_back(block{std::make_unique<char[]>(capacity), 0, capacity});
+    return &_blocks.back();
+  }
+
+  void _open_file() {
+    const char *dir = std::getenv("TMPDIR");
+    std::string path = dir && *dir ? dir : "/tmp";
+    path.append("/mariadb_modern_cpp_spill_XXXXXX");
+    const int fd = ::mkstemp(path.data());
+    if (fd < 0) {
+      _fail();
+    }
+    // the file is removed once closed
+    ::unlink(path.c_str());
+    _file = ::fdopen(fd, "w+b");
+    if (!_file) {
+      ::close(fd);
+      _fail();
+    }
+  }
+
+  [[noreturn]] static void _fail() {
+    throw mariadb_exception(
+        std::string("spilling rows to a temporary file failed: ") +
+        std::strerror(errno));
+  }
+
+  void _put_varint(uint64_t value) {
+    while (value >= 0x80) {
+      _encoded.push_back(static_cast<char>((value & 0x7f) | 0x80));
+      value >>= 7;
+    }
+    _encoded.push_back(static_cast<char>(value));
+  }
+
+  static uint64_t _get_varint(const char *&pos) noexcept {
+    uint64_t value = 0;
+    unsigned shift = 0;
+    while (true) {
+      const auto byte = static_cast<unsigned char>(*pos++);
+      value |= uint64_t(byte & 0x7f) << shift;
+      if (byte < 0x80) {
+        return value;
+      }
+      shift += 7;
+    }
+  }
+
+  size_t _memory_budget;
+  unsigned int _column_count;
+  std::string _encoded;
+  std::vector<block> _blocks;
+  size_t _reserved{};
+  std::FILE *_file{};
+  char *_map{};
+  uint64_t _rows{};
+  uint64_t _spilled_rows{};
+  uint64_t _spilled_bytes{};
+  size_t _read_block{};
+  size_t _read_offset{};
+};
+
+struct buffered_access {
+  template <typename Policy, typename Function>
+  static buffered_result_info extract(basic_statement_binder<Policy> &stmt,
+                                      Function &&func, size_t memory_budget) {
+    using traits = utility::function_traits<Function>;
+    using binder_type = basic_statement_binder<Policy>;
+    stmt._column_error.reset();
+
+    const bool timed = statement_stats::enabled();
+    const auto start = timed ? std::chrono::steady_clock::now()
+                             : std::chrono::steady_clock::time_point{};
+    const bool executed = !stmt.used();
+    if (executed) {
+      if (auto res = stmt._run(); !res) {
+        if (timed) {
+          stmt._record(start, 0, true, true, binder_type::_timed_out(res));
+        }
+        stmt._raise(res.error());
+      }
+    }
+    MYSQL *db = stmt._db.get();
+    std::unique_ptr<MYSQL_RES, void (*)(MYSQL_RES *)> result_set(
+        mysql_use_result(db), mysql_free_result);
+    if (!result_set) {
+      stmt._watch.disarm();
+      if (mysql_errno(db) != 0) {
+        stmt._raise(stmt._error_of(error::from(db)));
+      }
+      stmt._raise(error(error_kind::no_result_sets));
+    }
+
+    const auto column_count = mysql_num_fields(result_set.get());
+    spill_buffer buffer(memory_budget, column_count);
+    try {
+      while (auto row = mysql_fetch_row(result_set.get())) {
+        buffer.add_row(row, mysql_fetch_lengths(result_set.get()));
+      }
+    } catch (...) {
+      // freeing the result skips the rows left
+      result_set.reset();
+      stmt._watch.disarm();
+      throw;
+    }
+    // the query can be killed while its rows are read
+    stmt._watch.disarm();
+    const auto info = buffer.info();
+    const bool failed = mysql_errno(db) != 0;
+    const auto fetch_error =
+        failed ? std::optional<error>(stmt._error_of(error::from(db)))
+               : std::nullopt;
+    if (timed) {
+      stmt._record(start, info.rows, failed, executed,
+                   fetch_error &&
+                       fetch_error->kind() == error_kind::deadline_exceeded);
+    }
+    if (fetch_error) {
+      stmt._raise(*fetch_error);
+    }
+    // the connection is free from here,the callback may run statements on
+    // it
+    const bool more_result_sets = mysql_more_results(db);
+    buffer.finish();
+
+    std::vector<MYSQL_FIELD> field_storage(
+        mysql_fetch_fields(result_set.get()),
+        mysql_fetch_fields(result_set.get()) + column_count);
+    std::vector<char *> row_storage(column_count);
+    std::vector<unsigned long> length_storage(column_count);
+    auto cleanup = std::shared_ptr<void>(nullptr, [&stmt](void *) noexcept {
+      stmt.row = {};
+      stmt.lengths = {};
+      stmt.fields = {};
+      stmt.field_count = {};
+      if (stmt._arena) {
+        stmt._arena->resource.release();
+      }
+    });
+    while (buffer.next(row_storage.data(), length_storage.data())) {
+      stmt.row = row_storage.data();
+      stmt.lengths = length_storage.data();
+      stmt.fields = field_storage.data();
+      stmt.field_count = column_count;
+      binder_type::template binder<traits::arity>::run(stmt, func);
+      if (stmt._column_error) {
+        stmt._raise(error(stmt._column_error->kind,
+                          stmt._column_error->column,
+                          stmt._column_error->detail));
+      }
+      if (stmt._arena && stmt._arena->reset == arena_reset::per_row) {
+        stmt._arena->resource.release();
+      }
+    }
+    if (more_result_sets) {
+      stmt._raise(error(error_kind::more_result_sets));
+    }
+    return info;
+  }
+};
+
+} // namespace detail
+
+// Extracts the rows of `stmt` into `func` like `operator>>`,but reads all
+// rows before the first call,so `func` can run other statements on the
+// same connection. At most `memory_budget` bytes of rows,and at most
+// result_memory::budget() for all buffered results of the process,are held
+// in memory. The other rows spill to a memory mapped temporary file.
+template <typename Policy, typename Function>
+buffered_result_info
+extract_buffered(basic_statement_binder<Policy> &stmt, Function &&func,
+                 size_t memory_budget = default_result_memory_budget) {
+  return detail::buffered_access::extract(stmt, std::forward<Function>(func),
+                                          memory_budget);
+}
+
+template <typename Policy, typename Function>
+buffered_result_info
+extract_buffered(basic_statement_binder<Policy> &&stmt, Function &&func,
+                 size_t memory_budget = default_result_memory_budget) {
+  return detail::buffered_access::extract(stmt, std::forward<Function>(func),
+                                          memory_budget);
+}
+
+} // namespace mariadb
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "../mariadb_modern_cpp.hpp"
+
+namespace mariadb {
+
+struct load_result {
+  my_ulonglong rows{};
+  unsigned int warnings{};
+};
+
+// Feeds rows to LOAD DATA LOCAL INFILE through the connector's infile
+// callbacks. Rows are serialized as tab separated text by type_converter
+// only when the connector asks for more data, so memory use doesn't depend
+// on the number of rows. The connection must be created with
+// mariadb_config::local_infile.
+//
+// Fields of the big5, cp932, gb18030, gbk and sjis character sets can't be
+// escaped byte by byte, so with these as the character set of the
+// connection the rows are sent as multi-row INSERT statements instead.
+//
+// A load stopped by an exception of the range or of a type_converter keeps
+// the rows sent before it, unless it runs in a transaction that is rolled
+// back.
+class bulk_loader {
+public:
+  struct no_projection {};
+
+  // the size of the INSERT statements used instead of LOAD DATA
+  static constexpr size_t insert_batch_bytes = 1024 * 1024;
+
+  explicit bulk_loader(database &db) : _db(db.handle()) {}
+
+  // `rows` is a range of tuples, or of anything `projection` turns into a
+  // tuple (e.g. a lambda returning std::tie of struct members). The table and
+  // column names are spliced into the statement verbatim.
+  template <typename Range, typename Projection = no_projection>
+  load_result load(const std::string &table,
+                   const std::vector<std::string> &columns, const Range &rows,
+                   Projection projection = {}) {
+    using iterator_type = decltype(std::begin(rows));
+    row_stream<iterator_type, Projection> stream(
+        _db.get(), std::begin(rows), std::end(rows), std::move(projection));
+
+    std::string column_list = "(";
+    for (size_t i = 0; i < columns.size(); i++) {
+      if (i != 0) {
+        column_list.push_back(',');
+      }
+      column_list.append(columns[i]);
+    }
+    column_list.push_back(')');
+
+    const char *charset = mysql_character_set_name(_db.get());
+    if (!sql_writer::ascii_compatible(charset)) {
+      return _insert(table, column_list, stream);
+    }
+
+    std::string sql =
+        "LOAD DATA LOCAL INFILE 'mariadb_modern_cpp_bulk_loader' INTO TABLE ";
+    sql.append(table);
+    sql.append(" CHARACTER SET ");
+    sql.append(charset);
+    sql.append(" FIELDS TERMINATED BY '\\t' ESCAPED BY '\\\\' LINES "
+               "TERMINATED BY '\\n' ");
+    sql.append(column_list);
+
+    using stream_type = decltype(stream);
+    mysql_set_local_infile_handler(_db.get(), &_init, &_read<stream_type>,
+                                   &_end, &_error<stream_type>, &stream);
+    const auto res = mysql_real_query(_db.get(), sql.c_str(), sql.size());
+    mysql_set_local_infile_default(_db.get());
+
+    if (stream.exception) {
+      std::rethrow_exception(stream.exception);
+    }
+    if (res != 0) {
+      throw mariadb_exception(_db.get(), sql);
+    }
+    return {mysql_affected_rows(_db.get()), mysql_warning_count(_db.get())};
+  }
+
+private:
+  connection_handle _db;
+
+  template <typename Iterator, typename Projection> struct row_stream {
+    row_stream(MYSQL *connection, Iterator first, Iterator last,
+               Projection proj)
+        : db(connection), it(std::move(first)), end(std::move(last)),
+          projection(std::move(proj)) {}
+
+    // appends the fields of the next row to `out`,separated by `separator`
+    void append_row(std::string &out, sql_writer::target to, char separator) {
+      sql_writer writer(db, out, to);
+      std::apply(
+          [&](const auto &... fields) {
+            size_t field_idx = 0;
+            ((field_idx++ == 0 ? void() : out.push_back(separator),
+              type_converter<std::decay_t<decltype(fields)>>::to_sql(writer,
+                                                                     fields)),
+             ...);
+          },
+          _as_tuple(*it));
+      ++it;
+    }
+
+    // copies at most `size` bytes of serialized rows into `buffer`
+    size_t read(char *buffer, size_t size) {
+      while (pending.size() - offset < size && it != end) {
+        if (offset != 0) {
+          pending.erase(0, offset);
+          offset = 0;
+        }
+        append_row(pending, sql_writer::target::infile, '\t');
+        pending.push_back('\n');
+      }
+      const auto n = std::min(size, pending.size() - offset);
+      std::memcpy(buffer, pending.data() + offset, n);
+      offset += n;
+      return n;
+    }
+
+    template <typename Row> decltype(auto) _as_tuple(const Row &row) {
+      if constexpr (std::is_same_v<Projection, no_projection>) {
+        return (row);
+      } else {
+        return projection(row);
+      }
+    }
+
+    MYSQL *db;
+    Iterator it;
+    Iterator end;
+    Projection projection;
+    std::string pending;
+    size_t offset{};
+    std::exception_ptr exception;
+  };
+
+  template <typename Stream>
+  load_result _insert(const std::string &table, const std::string &column_list,
+                      Stream &stream) {
+    const std::string prefix =
+        "INSERT INTO " + table + " " + column_list + " VALUES ";
+    load_result res;
+    std::string sql;
+    while (stream.it != stream.end) {
+      sql = prefix;
+      do {
+        if (sql.size() != prefix.size()) {
+          sql.push_back(',');
+        }
+        sql.push_back('(');
+        stream.append_row(sql, sql_writer::target::statement, ',');
+        sql.push_back(')');
+      } while (stream.it != stream.end && sql.size() < insert_batch_bytes);
+      if (mysql_real_query(_db.get(), sql.data(), sql.size()) != 0) {
+        throw mariadb_exception(_db.get(), sql);
+      }
+      res.rows += mysql_affected_rows(_db.get());
+      res.warnings += mysql_warning_count(_db.get());
+    }
+    return res;
+  }
+
+  static int _init(void **ptr, const char *, void *userdata) {
+    *ptr = userdata;
+    return 0;
+  }
+
+  template <typename Stream>
+  static int _read(void *ptr, char *buffer, unsigned int size) {
+    auto &stream = *static_cast<Stream *>(ptr);
+    try {
+      return static_cast<int>(stream.read(buffer, size));
+    } catch (...) {
+      stream.exception = std::current_exception();
+      return -1;
+    }
+  }
+
+  static void _end(void *) {}
+
+  template <typename Stream>
+  static int _error(void *ptr, char *error_msg, unsigned int size) {
+    auto &stream = *static_cast<Stream *>(ptr);
+    std::snprintf(error_msg, size, "%s",
+                  stream.exception ? "bulk_loader row serialization failed"
+                                   : "bulk_loader failed");
+    return CR_UNKNOWN_ERROR;
+  }
+};
+
+} // namespace mariadb
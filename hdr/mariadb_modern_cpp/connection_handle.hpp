@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cassert>
+#include <memory>
+
+#include "errors.hpp"
+
+namespace mariadb {
+
+// A non-owning reference to a connection owned by a database,so creating a
+// statement doesn't touch the reference count shared by all threads. The
+// connection must outlive the handle,which is checked unless NDEBUG is
+// defined.
+class connection_handle {
+public:
+  connection_handle(const std::shared_ptr<MYSQL> &db) noexcept
+      : _db(db.get())
+#ifndef NDEBUG
+        ,
+        _owner(db)
+#endif
+  {
+  }
+
+  MYSQL *get() const noexcept {
+#ifndef NDEBUG
+    assert(!_owner.expired() && "connection closed before its statement");
+#endif
+    return _db;
+  }
+
+private:
+  MYSQL *_db;
+#ifndef NDEBUG
+  std::weak_ptr<MYSQL> _owner;
+#endif
+};
+
+} // namespace mariadb
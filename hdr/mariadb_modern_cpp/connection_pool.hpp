@@ -0,0 +1,115 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "../mariadb_modern_cpp.hpp"
+
+namespace mariadb {
+
+// A fixed size pool of connections sharing one configuration,connections are
+// created on demand.
+class connection_pool {
+public:
+  // returns the connection to the pool when destructed
+  class lease {
+  public:
+    lease(const lease &) = delete;
+    lease &operator=(const lease &) = delete;
+    lease(lease &&other) noexcept
+        : _pool(other._pool), _db(std::move(other._db)) {}
+    lease &operator=(lease &&other) noexcept {
+      if (this != &other) {
+        _release();
+        _pool = other._pool;
+        _db = std::move(other._db);
+      }
+      return *this;
+    }
+    ~lease() { _release(); }
+
+    database &operator*() const noexcept { return *_db; }
+    database *operator->() const noexcept { return _db.get(); }
+
+  private:
+    friend class connection_pool;
+    lease(connection_pool *pool, std::unique_ptr<database> db) noexcept
+        : _pool(pool), _db(std::move(db)) {}
+
+    void _release() noexcept {
+      if (_db) {
+        _pool->_release(std::move(_db));
+      }
+    }
+
+    connection_pool *_pool;
+    std::unique_ptr<database> _db;
+  };
+
+  // with `reset_on_release` connections are returned through
+  // database::reset(),so that no session state leaks between leases
+  connection_pool(mariadb_config config, size_t max_size,
+                  bool reset_on_release = false)
+      : _config(std::move(config)), _max_size(std::max<size_t>(max_size, 1)),
+        _reset_on_release(reset_on_release) {}
+
+  connection_pool(const connection_pool &) = delete;
+  connection_pool &operator=(const connection_pool &) = delete;
+
+  // blocks until a connection is available
+  lease acquire() {
+    {
+      std::unique_lock lk(_mtx);
+      _cv.wait(lk, [this] { return !_idle.empty() || _created < _max_size; });
+      if (!_idle.empty()) {
+        auto db = std::move(_idle.back());
+        _idle.pop_back();
+        return lease(this, std::move(db));
+      }
+      _created++;
+    }
+    try {
+      return lease(this, std::make_unique<database>(_config));
+    } catch (...) {
+      std::lock_guard lk(_mtx);
+      _created--;
+      _cv.notify_one();
+      throw;
+    }
+  }
+
+  size_t max_size() const noexcept { return _max_size; }
+  const mariadb_config &config() const noexcept { return _config; }
+
+private:
+  void _release(std::unique_ptr<database> db) noexcept {
+    if (_reset_on_release) {
+      try {
+        db->reset();
+      } catch (...) {
+        // a broken connection is dropped and replaced on demand
+        db.reset();
+      }
+    }
+    std::lock_guard lk(_mtx);
+    if (db) {
+      _idle.push_back(std::move(db));
+    } else {
+      _created--;
+    }
+    _cv.notify_one();
+  }
+
+  mariadb_config _config;
+  size_t _max_size;
+  bool _reset_on_release;
+  std::mutex _mtx;
+  std::condition_variable _cv;
+  std::vector<std::unique_ptr<database>> _idle;
+  size_t _created{};
+};
+
+} // namespace mariadb
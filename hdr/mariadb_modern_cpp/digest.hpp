@@ -0,0 +1,195 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace mariadb {
+
+namespace detail {
+
+inline bool is_word_char(char c) noexcept {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '_' || c == '$' ||
+         static_cast<unsigned char>(c) >= 0x80;
+}
+
+// Writes the normalized form of a sql statement to `sink`:
+// - comments are removed and whitespace is kept only between words
+// - words out of backquotes are lowercased
+// - string and numeric literals become '?'
+// - runs of two or more placeholders separated by commas become `?+`,so
+//   `in (?,?,?)` becomes `in(?+)`. This isn't limited to IN lists:
+//   `select 1,2` and `select 1,2,3` both become `select ?+`,and share a
+//   digest,while `select 1` stays `select ?`
+template <typename Sink> class sql_normalizer {
+public:
+  explicit sql_normalizer(Sink &sink) noexcept : _sink(sink) {}
+
+  void normalize(std::string_view sql) {
+    size_t i = 0;
+    const auto n = sql.size();
+    while (i < n) {
+      const char c = sql[i];
+      if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f') {
+        _space = true;
+        i++;
+      } else if (c == '#' ||
+                 (c == '-' && i + 2 < n && sql[i + 1] == '-' &&
+                  (sql[i + 2] == ' ' || sql[i + 2] == '\t'))) {
+        while (i < n && sql[i] != '\n') {
+          i++;
+        }
+        _space = true;
+      } else if (c == '/' && i + 1 < n && sql[i + 1] == '*') {
+        const auto end = sql.find("*/", i + 2);
+        i = end == sql.npos ? n : end + 2;
+        _space = true;
+      } else if (c == '\'' || c == '"') {
+        i++;
+        while (i < n) {
+          if (sql[i] == '\\') {
+            i += 2;
+          } else if (sql[i] == c) {
+            if (i + 1 < n && sql[i + 1] == c) {
+              i += 2;
+            } else {
+              i++;
+              break;
+            }
+          } else {
+            i++;
+          }
+        }
+        _placeholder();
+      } else if (c == '`') {
+        const auto end = sql.find('`', i + 1);
+        const auto stop = end == sql.npos ? n : end + 1;
+        _word(sql.substr(i, stop - i), false);
+        i = stop;
+      } else if (c >= '0' && c <= '9') {
+        i++;
+        while (i < n && (is_word_char(sql[i]) || sql[i] == '.' ||
+                         ((sql[i] == '+' || sql[i] == '-') &&
+                          (sql[i - 1] == 'e' || sql[i - 1] == 'E')))) {
+          i++;
+        }
+        _placeholder();
+      } else if (c == '?') {
+        i++;
+        _placeholder();
+      } else if (is_word_char(c)) {
+        const auto begin = i;
+        while (i < n && is_word_char(sql[i])) {
+          i++;
+        }
+        _word(sql.substr(begin, i - begin), true);
+      } else if (c == ',' && _last_placeholder && !_pending_comma) {
+        _pending_comma = true;
+        _space = false;
+        i++;
+      } else {
+        _flush_comma();
+        _sink.put(c);
+        _last = c;
+        _last_placeholder = false;
+        _space = false;
+        i++;
+      }
+    }
+    _flush_comma();
+  }
+
+private:
+  void _flush_comma() {
+    if (_pending_comma) {
+      _sink.put(',');
+      _last = ',';
+      _pending_comma = false;
+      _space = false;
+    }
+  }
+
+  static bool _joins(char c) noexcept {
+    return is_word_char(c) || c == '?' || c == '`';
+  }
+
+  void _separate(char next) {
+    if (_space && _joins(_last) && _joins(next)) {
+      _sink.put(' ');
+    }
+    _space = false;
+  }
+
+  void _word(std::string_view word, bool lowercase) {
+    _flush_comma();
+    _separate(word[0]);
+    for (char c : word) {
+      _sink.put(lowercase && c >= 'A' && c <= 'Z' ? char(c - 'A' + 'a') : c);
+    }
+    _last = word.back();
+    _last_placeholder = false;
+    _collapsed = false;
+  }
+
+  void _placeholder() {
+    if (_pending_comma) {
+      // one more element of a list
+      _pending_comma = false;
+      _space = false;
+      if (!_collapsed) {
+        _sink.put('+');
+        _collapsed = true;
+      }
+      return;
+    }
+    _separate('?');
+    _sink.put('?');
+    _last = '?';
+    _last_placeholder = true;
+    _collapsed = false;
+  }
+
+  Sink &_sink;
+  char _last{'\0'};
+  bool _space{false};
+  bool _last_placeholder{false};
+  bool _pending_comma{false};
+  bool _collapsed{false};
+};
+
+struct string_sink {
+  void put(char c) { out.push_back(c); }
+  std::string out;
+};
+
+// 64 bit FNV-1a
+struct fnv1a_sink {
+  void put(char c) noexcept {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 0x100000001b3ULL;
+  }
+  uint64_t hash{0xcbf29ce484222325ULL};
+};
+
+} // namespace detail
+
+// The statement with literals replaced by '?',see detail::sql_normalizer
+inline std::string normalize_sql(std::string_view sql) {
+  detail::string_sink sink;
+  sink.out.reserve(sql.size());
+  detail::sql_normalizer<detail::string_sink>(sink).normalize(sql);
+  return std::move(sink.out);
+}
+
+// A hash of the normalized statement,the same for statements differing only
+// in literal values,whitespace,comments,keyword case or list lengths.
+// It's never 0.
+inline uint64_t sql_digest(std::string_view sql) noexcept {
+  detail::fnv1a_sink sink;
+  detail::sql_normalizer<detail::fnv1a_sink>(sink).normalize(sql);
+  return sink.hash == 0 ? 1 : sink.hash;
+}
+
+} // namespace mariadb
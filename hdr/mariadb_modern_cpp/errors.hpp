@@ -23,10 +23,21 @@ public:
             msg + (sql.empty() ? "" : (std::string(" \nerror sql :") + sql))),
         _sql(std::move(sql)) {}
 
+  mariadb_exception(unsigned int error_code, std::string msg,
+                    std::string sql = "")
+      : mariadb_exception(std::move(msg), std::move(sql)) {
+    _errno = error_code;
+  }
+
   mariadb_exception(MYSQL *mysql, std::string sql = "")
       : mariadb_exception(mysql_error(mysql), std::move(sql)) {
     _errno = mysql_errno(mysql);
   }
+
+  mariadb_exception(MYSQL_STMT *stmt, std::string sql = "")
+      : mariadb_exception(mysql_stmt_error(stmt), std::move(sql)) {
+    _errno = mysql_stmt_errno(stmt);
+  }
   const std::string &get_sql() const noexcept { return _sql; }
   auto get_errno() const noexcept -> auto { return _errno; }
 
@@ -77,5 +88,13 @@ class can_not_hold_null : public mariadb_exception {
 class bad_alignment : public mariadb_exception {
   using mariadb_exception::mariadb_exception;
 };
+// A statement with a deadline was aborted by max_statement_time or killed
+class deadline_exceeded : public mariadb_exception {
+  using mariadb_exception::mariadb_exception;
+};
+// A statement was rejected by an admission_controller
+class overloaded : public mariadb_exception {
+  using mariadb_exception::mariadb_exception;
+};
 } // namespace exceptions
 } // namespace mariadb
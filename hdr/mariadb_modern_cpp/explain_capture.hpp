@@ -0,0 +1,315 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../mariadb_modern_cpp.hpp"
+
+namespace mariadb {
+
+struct explain_capture_options {
+  // statements taking at least this long are explained
+  std::chrono::milliseconds threshold{1000};
+  // captures kept,the oldest are dropped
+  size_t capacity{64};
+  // EXPLAINs started per second on average,and at most `burst` at once
+  double rate{1.0};
+  size_t burst{4};
+  // a digest is explained at most once per interval
+  std::chrono::seconds digest_interval{60};
+  // captures waiting for the side connection,the others are dropped
+  size_t max_pending{8};
+  // longer statements are recorded truncated and not explained
+  size_t max_sql_bytes{64 * 1024};
+  // max_statement_time of the EXPLAINs,0 for none
+  std::chrono::milliseconds explain_timeout{2000};
+};
+
+struct explained_statement {
+  uint64_t digest{};
+  // the statement with its arguments
+  std::string sql;
+  std::chrono::system_clock::time_point time;
+  std::chrono::nanoseconds latency{};
+  // 0 for statements returning rows
+  uint64_t affected_rows{};
+  bool failed{};
+  // the EXPLAIN FORMAT=JSON output,empty if `error` says why
+  std::string plan;
+  std::string error;
+};
+
+struct explain_capture_stats {
+  // statements over the threshold
+  uint64_t slow{};
+  // skipped as their digest was explained within digest_interval
+  uint64_t repeated{};
+  // skipped by the rate or max_pending
+  uint64_t rate_limited{};
+  uint64_t explained{};
+  // captures without a plan
+  uint64_t failed{};
+};
+
+namespace detail {
+
+// EXPLAIN accepts these statements only
+inline bool explainable(std::string_view sql) noexcept {
+  size_t pos = 0;
+  while (pos < sql.size() &&
+         (std::isspace(static_cast<unsigned char>(sql[pos])) ||
+          sql[pos] == '(')) {
+    pos++;
+  }
+  size_t end = pos;
+  while (end < sql.size() &&
+         std::isalpha(static_cast<unsigned char>(sql[end]))) {
+    end++;
+  }
+  const auto word = sql.substr(pos, end - pos);
+  for (std::string_view keyword :
+       {"select", "insert", "replace", "update", "delete", "with"}) {
+    if (word.size() == keyword.size() &&
+        std::equal(word.begin(), word.end(), keyword.begin(),
+                   [](char a, char b) {
+                     return std::tolower(static_cast<unsigned char>(a)) == b;
+                   })) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace detail
+
+// Runs EXPLAIN FORMAT=JSON for the statements of statement_binder which take
+// longer than the threshold,while it exists. The EXPLAINs run on a side
+// connection from a thread of their own,rate limited and at most once per
+// digest and interval,so that they add little load when many statements
+// are slow at once. The plans are kept with the timings of their statements
+// in a ring of the last `capacity` captures.
+//
+// Only one explain_capture can exist at a time. The side connection uses
+// `config`,so statements depending on session state,like temporary tables
+// or a database selected by USE,may fail to be explained.
+class explain_capture : public slow_statement_sink {
+public:
+  explicit explain_capture(const mariadb_config &config,
+                           explain_capture_options options = {})
+      : _config(config), _options(std::move(options)),
+        _tokens(static_cast<double>(_options.burst)),
+        _refilled(std::chrono::steady_clock::now()) {
+    _config.warm_statements.clear();
+    if (_options.explain_timeout.count() > 0) {
+      char value[32];
+      std::snprintf(value, sizeof(value), "%.3f",
+                    static_cast<double>(_options.explain_timeout.count()) /
+                        1000);
+      _config.session_variables.emplace_back("max_statement_time", value);
+    }
+    _thread = std::thread([this] { _run(); });
+    try {
+      detail::slow_statement_hook::install(this, _options.threshold);
+    } catch (...) {
+      _stop_thread();
+      throw;
+    }
+  }
+
+  explain_capture(const explain_capture &) = delete;
+  explain_capture &operator=(const explain_capture &) = delete;
+
+  ~explain_capture() override {
+    detail::slow_statement_hook::uninstall(this);
+    _stop_thread();
+  }
+
+  // the captures,oldest first
+  std::vector<explained_statement> captures() const {
+    std::lock_guard lk(_mtx);
+    return {_captures.begin(), _captures.end()};
+  }
+
+  explain_capture_stats stats() const {
+    std::lock_guard lk(_mtx);
+    return _stats;
+  }
+
+  // returns once the pending EXPLAINs are done
+  void flush() {
+    std::unique_lock lk(_mtx);
+    _idle_cv.wait(lk, [this] { return _pending.empty() && !_busy; });
+  }
+
+  void slow_statement(uint64_t digest, std::string_view sql,
+                      std::chrono::nanoseconds latency, uint64_t affected_rows,
+                      bool failed) noexcept override {
+    try {
+      std::lock_guard lk(_mtx);
+      _stats.slow++;
+      const auto now = std::chrono::steady_clock::now();
+      if (auto it = _explained_at.find(digest);
+          it != _explained_at.end() &&
+          now - it->second < _options.digest_interval) {
+        _stats.repeated++;
+        return;
+      }
+      const std::chrono::duration<double> elapsed = now - _refilled;
+      _tokens = std::min(static_cast<double>(_options.burst),
+                         _tokens + elapsed.count() * _options.rate);
+      _refilled = now;
+      if (_tokens < 1 || _pending.size() >= _options.max_pending) {
+        _stats.rate_limited++;
+        return;
+      }
+      _tokens -= 1;
+      if (_explained_at.size() >= max_tracked_digests) {
+        _forget_digests(now);
+      }
+      _explained_at[digest] = now;
+
+      explained_statement capture;
+      capture.digest = digest;
+      capture.sql = sql.substr(0, _options.max_sql_bytes);
+      capture.time = std::chrono::system_clock::now();
+      capture.latency = latency;
+      capture.affected_rows = affected_rows;
+      capture.failed = failed;
+      if (sql.size() > _options.max_sql_bytes) {
+        capture.error = "statement too long to explain";
+      } else if (!detail::explainable(sql)) {
+        capture.error = "statement can't be explained";
+      }
+      _pending.push_back(std::move(capture));
+    } catch (...) {
+      return;
+    }
+    _cv.notify_one();
+  }
+
+private:
+  static constexpr size_t max_tracked_digests = 4096;
+
+  void _stop_thread() noexcept {
+    {
+      std::lock_guard lk(_mtx);
+      _stop = true;
+    }
+    _cv.notify_all();
+    _thread.join();
+  }
+
+  void _run() {
+    init_thread();
+    // the session setup of the side connection isn't captured
+    detail::slow_statement_hook::mute_thread();
+    std::unique_lock lk(_mtx);
+    while (true) {
+      _cv.wait(lk, [this] { return _stop || !_pending.empty(); });
+      // pending EXPLAINs are dropped
+      if (_stop) {
+        break;
+      }
+      auto capture = std::move(_pending.front());
+      _pending.pop_front();
+      _busy = true;
+      lk.unlock();
+      if (capture.error.empty()) {
+        _explain(capture);
+      }
+      lk.lock();
+      _busy = false;
+      if (capture.plan.empty()) {
+        _stats.failed++;
+      } else {
+        _stats.explained++;
+      }
+      if (_options.capacity > 0) {
+        if (_captures.size() >= _options.capacity) {
+          _captures.pop_front();
+        }
+        _captures.push_back(std::move(capture));
+      }
+      _idle_cv.notify_all();
+    }
+    _pending.clear();
+    _idle_cv.notify_all();
+  }
+
+  void _explain(explained_statement &capture) {
+    if (!_db) {
+      try {
+        _db = std::make_unique<database>(_config);
+      } catch (const mariadb_exception &e) {
+        capture.error = e.what();
+        return;
+      }
+    }
+    MYSQL *db = _db->handle().get();
+    const std::string sql = "EXPLAIN FORMAT=JSON " + capture.sql;
+    if (mysql_real_query(db, sql.data(), sql.size()) != 0) {
+      capture.error = mysql_error(db);
+      if (mysql_errno(db) >= CR_MIN_ERROR) {
+        // reconnect for the next capture
+        _db.reset();
+      }
+      return;
+    }
+    std::unique_ptr<MYSQL_RES, void (*)(MYSQL_RES *)> result_set(
+        mysql_store_result(db), mysql_free_result);
+    const auto row = result_set ? mysql_fetch_row(result_set.get()) : nullptr;
+    if (row && row[0]) {
+      capture.plan.assign(row[0], mysql_fetch_lengths(result_set.get())[0]);
+    } else {
+      capture.error = "EXPLAIN returned no plan";
+    }
+  }
+
+  // forgets the digests explained before the interval
+  void _forget_digests(std::chrono::steady_clock::time_point now) {
+    for (auto it = _explained_at.begin(); it != _explained_at.end();) {
+      if (now - it->second >= _options.digest_interval) {
+        it = _explained_at.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    if (_explained_at.size() >= max_tracked_digests) {
+      _explained_at.clear();
+    }
+  }
+
+  mariadb_config _config;
+  explain_capture_options _options;
+  // used by the thread only
+  std::unique_ptr<database> _db;
+
+  mutable std::mutex _mtx;
+  std::condition_variable _cv;
+  std::condition_variable _idle_cv;
+  bool _stop{false};
+  bool _busy{false};
+  std::deque<explained_statement> _pending;
+  std::deque<explained_statement> _captures;
+  explain_capture_stats _stats;
+  // a token bucket of EXPLAINs
+  double _tokens;
+  std::chrono::steady_clock::time_point _refilled;
+  std::unordered_map<uint64_t, std::chrono::steady_clock::time_point>
+      _explained_at;
+  std::thread _thread;
+};
+
+} // namespace mariadb
@@ -0,0 +1,257 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <future>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "../mariadb_modern_cpp.hpp"
+
+namespace mariadb {
+
+struct page_metrics {
+  size_t rows{};
+  // time spent by the query and the decoding of the page
+  std::chrono::nanoseconds fetch_time{};
+  // time next_page() waited for it,short when it was prefetched in time
+  std::chrono::nanoseconds wait_time{};
+  bool prefetched{false};
+
+  double rows_per_second() const noexcept {
+    const auto seconds = std::chrono::duration<double>(fetch_time).count();
+    return seconds > 0 ? static_cast<double>(rows) / seconds : 0;
+  }
+};
+
+// Pages through the result of `base_query` ordered by its first KeyCount
+// columns,which must be unique together. Each page is read with
+//   SELECT * FROM (base_query) AS _keyset WHERE (k1,k2) > (?,?)
+//   ORDER BY k1,k2 LIMIT page_size
+// so a page costs the same wherever it is. Keys must be integers or strings.
+template <size_t KeyCount, typename... Columns> class keyset_cursor {
+  static_assert(KeyCount > 0 && KeyCount <= sizeof...(Columns),
+                "key columns must be the leading columns");
+
+public:
+  using row_type = std::tuple<Columns...>;
+
+private:
+  template <size_t... Index>
+  static auto _key_tuple(std::index_sequence<Index...>)
+      -> std::tuple<std::tuple_element_t<Index, row_type>...>;
+
+public:
+  using key_type =
+      decltype(_key_tuple(std::make_index_sequence<KeyCount>()));
+
+  keyset_cursor(database &db, std::string base_query,
+                std::vector<std::string> key_columns, size_t page_size)
+      : keyset_cursor(db, nullptr, std::move(base_query),
+                      std::move(key_columns), page_size) {}
+
+  // pages after the first one are read ahead on `prefetch_db`,which must not
+  // be used elsewhere meanwhile
+  keyset_cursor(database &db, database &prefetch_db, std::string base_query,
+                std::vector<std::string> key_columns, size_t page_size)
+      : keyset_cursor(db, &prefetch_db, std::move(base_query),
+                      std::move(key_columns), page_size) {}
+
+  keyset_cursor(const keyset_cursor &) = delete;
+  keyset_cursor &operator=(const keyset_cursor &) = delete;
+
+  // returns an empty page after the last one
+  const std::vector<row_type> &next_page() {
+    const auto start = std::chrono::steady_clock::now();
+    if (_prefetch.valid()) {
+      _metrics.prefetched = _prefetch.wait_for(std::chrono::seconds(0)) ==
+                            std::future_status::ready;
+      auto page = _prefetch.get();
+      _page = std::move(page.rows);
+      _metrics.fetch_time = page.fetch_time;
+    } else if (_done) {
+      _page.clear();
+      _metrics.prefetched = false;
+      _metrics.fetch_time = {};
+    } else {
+      auto page = _fetch(*_db, _last_key);
+      _page = std::move(page.rows);
+      _metrics.prefetched = false;
+      _metrics.fetch_time = page.fetch_time;
+    }
+    _metrics.wait_time = std::chrono::steady_clock::now() - start;
+    _metrics.rows = _page.size();
+
+    if (_page.size() < _page_size) {
+      _done = true;
+    }
+    if (!_page.empty()) {
+      _last_key = _key_of(_page.back(), std::make_index_sequence<KeyCount>());
+    }
+    if (!_done && _prefetch_db) {
+      _prefetch = std::async(std::launch::async,
+                             [this, key = _last_key] {
+                               init_thread();
+                               return _fetch(*_prefetch_db, key);
+                             });
+    }
+    return _page;
+  }
+
+  const page_metrics &last_page_metrics() const noexcept { return _metrics; }
+  const std::optional<key_type> &last_key() const noexcept { return _last_key; }
+
+  // a token to continue after the last page returned,empty before the first
+  std::string token() const {
+    std::string token;
+    if (_last_key) {
+      std::apply(
+          [&token](const auto &... keys) { (_encode(token, keys), ...); },
+          *_last_key);
+    }
+    return token;
+  }
+
+  // continues after the page the token was taken after
+  void resume(const std::string &token) {
+    _drop_prefetch();
+    _done = false;
+    if (token.empty()) {
+      _last_key.reset();
+      return;
+    }
+    key_type key;
+    std::string_view rest(token);
+    const bool ok = std::apply(
+        [&rest](auto &... keys) { return (_decode(rest, keys) && ...); }, key);
+    if (!ok || !rest.empty()) {
+      throw mariadb_exception("invalid keyset_cursor token");
+    }
+    _last_key = std::move(key);
+  }
+
+  ~keyset_cursor() { _drop_prefetch(); }
+
+private:
+  struct fetched_page {
+    std::vector<row_type> rows;
+    std::chrono::nanoseconds fetch_time;
+  };
+
+  struct row_collector {
+    std::vector<row_type> *rows;
+    void operator()(Columns... values) const {
+      rows->emplace_back(std::move(values)...);
+    }
+  };
+
+  keyset_cursor(database &db, database *prefetch_db, std::string base_query,
+                std::vector<std::string> key_columns, size_t page_size)
+      : _db(&db), _prefetch_db(prefetch_db),
+        _page_size(std::max<size_t>(page_size, 1)) {
+    if (key_columns.size() != KeyCount) {
+      throw mariadb_exception("keyset_cursor needs " +
+                              std::to_string(KeyCount) + " key columns");
+    }
+    std::string keys;
+    std::string placeholders;
+    for (const auto &column : key_columns) {
+      if (!keys.empty()) {
+        keys.push_back(',');
+        placeholders.push_back(',');
+      }
+      keys.append(column);
+      placeholders.push_back('?');
+    }
+    const auto select = "SELECT * FROM (" + base_query + ") AS _keyset";
+    const auto order = " ORDER BY " + keys + " LIMIT ?";
+    _first_page_sql = select + order;
+    _next_page_sql =
+        select + " WHERE (" + keys + ") > (" + placeholders + ")" + order;
+  }
+
+  fetched_page _fetch(database &db,
+                      const std::optional<key_type> &after) const {
+    const auto start = std::chrono::steady_clock::now();
+    fetched_page page;
+    page.rows.reserve(_page_size);
+    if (after) {
+      auto stmt = db << _next_page_sql;
+      std::apply([&stmt](const auto &... keys) { ((stmt << keys), ...); },
+                 *after);
+      stmt << _page_size >> row_collector{&page.rows};
+    } else {
+      db << _first_page_sql << _page_size >> row_collector{&page.rows};
+    }
+    page.fetch_time = std::chrono::steady_clock::now() - start;
+    return page;
+  }
+
+  template <size_t... Index>
+  static key_type _key_of(const row_type &row, std::index_sequence<Index...>) {
+    return key_type(std::get<Index>(row)...);
+  }
+
+  void _drop_prefetch() noexcept {
+    if (_prefetch.valid()) {
+      _prefetch.wait();
+      _prefetch = {};
+    }
+  }
+
+  // each key is written as its length,':' and its text
+  template <typename Key>
+  static void _encode(std::string &out, const Key &key) {
+    if constexpr (std::is_integral_v<Key>) {
+      _encode(out, std::to_string(key));
+    } else {
+      static_assert(std::is_same_v<Key, std::string>,
+                    "keyset_cursor keys must be integers or std::string");
+      out.append(std::to_string(key.size()));
+      out.push_back(':');
+      out.append(key);
+    }
+  }
+
+  template <typename Key>
+  static bool _decode(std::string_view &in, Key &key) {
+    size_t size{};
+    auto res = std::from_chars(in.data(), in.data() + in.size(), size);
+    if (res.ec != std::errc() || res.ptr == in.data() + in.size() ||
+        *res.ptr != ':') {
+      return false;
+    }
+    in.remove_prefix(static_cast<size_t>(res.ptr - in.data()) + 1);
+    if (size > in.size()) {
+      return false;
+    }
+    const auto text = in.substr(0, size);
+    in.remove_prefix(size);
+    if constexpr (std::is_integral_v<Key>) {
+      res = std::from_chars(text.data(), text.data() + text.size(), key);
+      return res.ec == std::errc() && res.ptr == text.data() + text.size();
+    } else {
+      key.assign(text.data(), text.size());
+      return true;
+    }
+  }
+
+  database *_db;
+  database *_prefetch_db;
+  size_t _page_size;
+  std::string _first_page_sql;
+  std::string _next_page_sql;
+  std::vector<row_type> _page;
+  std::optional<key_type> _last_key;
+  std::future<fetched_page> _prefetch;
+  page_metrics _metrics;
+  bool _done{false};
+};
+
+} // namespace mariadb
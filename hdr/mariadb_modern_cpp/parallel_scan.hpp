@@ -0,0 +1,256 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "connection_pool.hpp"
+
+namespace mariadb {
+
+enum class scan_order {
+  // the callback is invoked concurrently from the worker threads
+  unordered,
+  // the callback is invoked from the calling thread in key order
+  ordered,
+};
+
+enum class scan_snapshot {
+  none,
+  // each connection reads from its own consistent snapshot
+  per_connection,
+  // all connections read from the same snapshot,FLUSH TABLES WITH READ LOCK
+  // is held while the snapshots are started and needs the RELOAD privilege
+  synchronized,
+};
+
+struct parallel_scan_options {
+  size_t parallelism{4};
+  // number of keys read by one query
+  long long chunk_size{10000};
+  scan_order order{scan_order::unordered};
+  scan_snapshot snapshot{scan_snapshot::none};
+  // the select list,spliced into the statement verbatim
+  std::string columns{"*"};
+  // chunks decoded ahead of the one being delivered in ordered mode,
+  // 0 means twice the parallelism
+  size_t ordered_window{0};
+};
+
+namespace detail {
+
+template <typename Function, typename Indices> struct scan_row_tuple;
+template <typename Function, size_t... Index>
+struct scan_row_tuple<Function, std::index_sequence<Index...>> {
+  using type = std::tuple<std::remove_cv_t<std::remove_reference_t<
+      typename utility::function_traits<Function>::template argument<Index>>>...>;
+};
+
+template <typename Tuple> struct scan_row_collector;
+template <typename... Values> struct scan_row_collector<std::tuple<Values...>> {
+  std::vector<std::tuple<Values...>> *rows;
+  void operator()(Values... values) const {
+    rows->emplace_back(std::move(values)...);
+  }
+};
+
+// ends the snapshot transaction of a scan which failed,so the connection
+// doesn't return to the pool inside it
+inline void scan_rollback(database &db) noexcept {
+  try {
+    (void)db.statement("ROLLBACK").try_execute();
+  } catch (...) {
+  }
+}
+
+} // namespace detail
+
+// Reads the rows of `table` whose integer key `key_column` is in
+// [first_key,last_key) over several pooled connections. The key range is
+// split into chunks of options.chunk_size keys which the workers pull one at
+// a time. The callback takes the selected columns like `operator>>`.
+template <typename Function>
+void parallel_scan(connection_pool &pool, const std::string &table,
+                   const std::string &key_column, long long first_key,
+                   long long last_key, Function &&callback,
+                   const parallel_scan_options &options = {}) {
+  if (last_key <= first_key) {
+    return;
+  }
+  const long long chunk_size = std::max(options.chunk_size, 1LL);
+  const size_t chunk_count = static_cast<size_t>(
+      (last_key - first_key - 1) / chunk_size + 1);
+  const size_t worker_count = std::min(
+      {std::max<size_t>(options.parallelism, 1), pool.max_size(), chunk_count});
+
+  std::string sql = "SELECT " + options.columns + " FROM " + table +
+                    " WHERE " + key_column + " >= ? AND " + key_column +
+                    " < ?";
+  if (options.order == scan_order::ordered) {
+    sql += " ORDER BY " + key_column;
+  }
+
+  std::vector<connection_pool::lease> leases;
+  leases.reserve(worker_count);
+  for (size_t i = 0; i < worker_count; i++) {
+    leases.push_back(pool.acquire());
+  }
+  try {
+    if (options.snapshot == scan_snapshot::synchronized) {
+      // UNLOCK TABLES doesn't end a transaction started under a global read
+      // lock,so the first connection can hold the lock too
+      *leases[0] << "FLUSH TABLES WITH READ LOCK";
+      try {
+        for (size_t i = worker_count; i > 0; i--) {
+          *leases[i - 1] << "START TRANSACTION WITH CONSISTENT SNAPSHOT";
+        }
+      } catch (...) {
+        *leases[0] << "UNLOCK TABLES";
+        throw;
+      }
+      *leases[0] << "UNLOCK TABLES";
+    } else if (options.snapshot == scan_snapshot::per_connection) {
+      for (auto &lease : leases) {
+        *lease << "START TRANSACTION WITH CONSISTENT SNAPSHOT";
+      }
+    }
+  } catch (...) {
+    for (auto &lease : leases) {
+      detail::scan_rollback(*lease);
+    }
+    throw;
+  }
+
+  using traits = utility::function_traits<Function>;
+  using row_type = typename detail::scan_row_tuple<
+      Function, std::make_index_sequence<traits::arity>>::type;
+  const bool ordered = options.order == scan_order::ordered;
+  const size_t window =
+      options.ordered_window ? options.ordered_window : worker_count * 2;
+
+  std::atomic<size_t> next_chunk{0};
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::map<size_t, std::vector<row_type>> decoded;
+  size_t delivered{0};
+  size_t finished_workers{0};
+  std::exception_ptr failure;
+
+  auto fail = [&](std::exception_ptr e) {
+    std::lock_guard lk(mtx);
+    if (!failure) {
+      failure = e;
+    }
+    cv.notify_all();
+  };
+
+  auto worker = [&](database &db) {
+    init_thread();
+    try {
+      while (true) {
+        const size_t chunk = next_chunk.fetch_add(1);
+        if (chunk >= chunk_count) {
+          break;
+        }
+        if (ordered) {
+          std::unique_lock lk(mtx);
+          cv.wait(lk, [&] { return failure || chunk < delivered + window; });
+        }
+        {
+          std::lock_guard lk(mtx);
+          if (failure) {
+            break;
+          }
+        }
+        const long long lo =
+            first_key + static_cast<long long>(chunk) * chunk_size;
+        const long long hi = lo + std::min(chunk_size, last_key - lo);
+        if (ordered) {
+          std::vector<row_type> rows;
+          db << sql << lo << hi
+             >> detail::scan_row_collector<row_type>{&rows};
+          std::lock_guard lk(mtx);
+          decoded.emplace(chunk, std::move(rows));
+          cv.notify_all();
+        } else {
+          db << sql << lo << hi >> callback;
+        }
+      }
+      if (options.snapshot != scan_snapshot::none) {
+        db << "COMMIT";
+      }
+    } catch (...) {
+      if (options.snapshot != scan_snapshot::none) {
+        detail::scan_rollback(db);
+      }
+      fail(std::current_exception());
+    }
+    std::lock_guard lk(mtx);
+    finished_workers++;
+    cv.notify_all();
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(worker_count);
+  try {
+    for (size_t i = 0; i < worker_count; i++) {
+      threads.emplace_back(worker, std::ref(*leases[i]));
+    }
+  } catch (...) {
+    // the running workers stop,and are joined before the failure is
+    // rethrown
+    fail(std::current_exception());
+    if (options.snapshot != scan_snapshot::none) {
+      for (size_t i = threads.size(); i < worker_count; i++) {
+        detail::scan_rollback(*leases[i]);
+      }
+    }
+  }
+
+  if (ordered) {
+    try {
+      while (true) {
+        std::vector<row_type> rows;
+        {
+          std::unique_lock lk(mtx);
+          cv.wait(lk, [&] {
+            return failure || decoded.count(delivered) != 0 ||
+                   delivered == chunk_count;
+          });
+          if (failure || delivered == chunk_count) {
+            break;
+          }
+          auto it = decoded.find(delivered);
+          rows = std::move(it->second);
+          decoded.erase(it);
+        }
+        for (auto &row : rows) {
+          std::apply(callback, std::move(row));
+        }
+        std::lock_guard lk(mtx);
+        delivered++;
+        cv.notify_all();
+      }
+    } catch (...) {
+      fail(std::current_exception());
+    }
+  }
+
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  if (failure) {
+    std::rethrow_exception(failure);
+  }
+}
+
+} // namespace mariadb
@@ -0,0 +1,300 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "../mariadb_modern_cpp.hpp"
+#include "utility/bounded_ring.hpp"
+
+namespace mariadb {
+
+struct pipeline_options {
+  // rows copied from the connection before a batch is handed to a consumer
+  size_t batch_rows{1024};
+  // batches in flight,the fetcher waits when all of them are queued
+  size_t max_batches{8};
+  // threads decoding rows and invoking the callback,which must be thread safe
+  // if there is more than one
+  size_t consumers{1};
+};
+
+namespace detail {
+
+// raw cells of a batch of rows,copied out of the connector's row buffer
+struct row_batch {
+  static constexpr unsigned long null_length = ULONG_MAX;
+
+  void append(MYSQL_ROW row, const unsigned long *row_lengths,
+              unsigned int field_count) {
+    for (unsigned int i = 0; i < field_count; i++) {
+      if (row[i]) {
+        data.append(row[i], row_lengths[i]);
+        lengths.push_back(row_lengths[i]);
+      } else {
+        lengths.push_back(null_length);
+      }
+    }
+    rows++;
+  }
+
+  void clear() noexcept {
+    data.clear();
+    lengths.clear();
+    rows = 0;
+  }
+
+  std::string data;
+  std::vector<unsigned long> lengths;
+  size_t rows{};
+};
+
+// Lets threads sleep until a bounded_ring has what they wait for. The lock
+// is only taken by notify() while a thread waits,so the rings stay the fast
+// path.
+class ring_signal {
+public:
+  // waits until `ready` returns true,which is called under the lock
+  template <typename Ready> void wait(Ready ready) {
+    std::unique_lock lk(_mtx);
+    _waiters.fetch_add(1, std::memory_order_relaxed);
+    // pairs with the fence of notify(),so either `ready` sees the change or
+    // notify() sees the waiter
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    _cv.wait(lk, ready);
+    _waiters.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  // call after a change `ready` may be waiting for
+  void notify() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_waiters.load(std::memory_order_relaxed) != 0) {
+      {
+        std::lock_guard lk(_mtx);
+      }
+      _cv.notify_all();
+    }
+  }
+
+private:
+  std::mutex _mtx;
+  std::condition_variable _cv;
+  std::atomic<size_t> _waiters{0};
+};
+
+struct pipeline_access {
+  template <typename Policy, typename Function>
+  static void extract(basic_statement_binder<Policy> &stmt, Function &callback,
+                      const pipeline_options &options) {
+    using traits = utility::function_traits<Function>;
+    const auto sql = stmt.sql();
+    if (!stmt.used()) {
+      stmt.execute();
+    }
+    MYSQL *db = stmt._db.get();
+    std::unique_ptr<MYSQL_RES, void (*)(MYSQL_RES *)> result(
+        mysql_use_result(db), mysql_free_result);
+    if (!result) {
+      throw exceptions::no_result_sets(
+          "no result sets to extract: exactly 1 result set expected", sql);
+    }
+    const auto field_count = mysql_num_fields(result.get());
+    const MYSQL_FIELD *fields = mysql_fetch_fields(result.get());
+    if (traits::arity > field_count) {
+      throw exceptions::out_of_row_range(
+          std::string("try to access column ") +
+              std::to_string(traits::arity - 1) + " ,exceeds column count " +
+              std::to_string(field_count),
+          sql);
+    }
+
+    const size_t batch_rows = std::max<size_t>(options.batch_rows, 1);
+    utility::bounded_ring<std::unique_ptr<row_batch>> full(
+        std::max<size_t>(options.max_batches, 1));
+    // consumed batches are handed back to the fetcher for reuse
+    utility::bounded_ring<std::unique_ptr<row_batch>> empty(full.capacity());
+    size_t batch_count = 0;
+    // consumers wait for full batches,the fetcher for empty ones
+    ring_signal full_ready;
+    ring_signal empty_ready;
+
+    std::atomic<bool> fetch_done{false};
+    std::atomic<bool> failed{false};
+    std::mutex failure_mtx;
+    std::exception_ptr failure;
+    auto fail = [&](std::exception_ptr e) {
+      {
+        std::lock_guard lk(failure_mtx);
+        if (!failure) {
+          failure = e;
+        }
+        failed = true;
+      }
+      full_ready.notify();
+      empty_ready.notify();
+    };
+
+    auto consumer = [&] {
+      try {
+        std::vector<const char *> cells(field_count);
+        std::vector<unsigned long> lengths(field_count);
+        std::unique_ptr<row_batch> batch;
+        while (!failed) {
+          if (!full.try_pop(batch)) {
+            full_ready.wait(
+                [&] { return failed || fetch_done || full.try_pop(batch); });
+            if (!batch && (failed || !full.try_pop(batch))) {
+              break;
+            }
+          }
+          const char *data = batch->data.data();
+          size_t cell = 0;
+          for (size_t r = 0; r < batch->rows && !failed; r++) {
+            for (unsigned int i = 0; i < field_count; i++, cell++) {
+              lengths[i] = batch->lengths[cell];
+              if (lengths[i] == row_batch::null_length) {
+                cells[i] = nullptr;
+                lengths[i] = 0;
+              } else {
+                cells[i] = data;
+                data += lengths[i];
+              }
+            }
+            _consume_row(callback, cells.data(), lengths.data(), fields, sql,
+                         std::make_index_sequence<traits::arity>());
+          }
+          batch->clear();
+          // the ring of empty batches has room for every batch
+          empty.try_push(batch);
+          empty_ready.notify();
+          batch.reset();
+        }
+      } catch (...) {
+        fail(std::current_exception());
+      }
+    };
+
+    std::vector<std::thread> consumers;
+    const size_t consumer_count = std::max<size_t>(options.consumers, 1);
+    try {
+      for (size_t i = 0; i < consumer_count; i++) {
+        consumers.emplace_back(consumer);
+      }
+
+      std::unique_ptr<row_batch> batch;
+      // leaves `batch` empty only after a failure
+      auto next_batch = [&] {
+        if (empty.try_pop(batch)) {
+          return;
+        }
+        if (batch_count < full.capacity()) {
+          batch_count++;
+          batch = std::make_unique<row_batch>();
+          return;
+        }
+        empty_ready.wait([&] { return failed || empty.try_pop(batch); });
+      };
+      // the ring of full batches has room for every batch,the fetcher waits
+      // for an empty one instead
+      auto push_batch = [&] {
+        full.try_push(batch);
+        full_ready.notify();
+      };
+
+      next_batch();
+      while (!failed) {
+        MYSQL_ROW row = mysql_fetch_row(result.get());
+        if (!row) {
+          if (mysql_errno(db) != 0) {
+            throw mariadb_exception(db, sql);
+          }
+          break;
+        }
+        batch->append(row, mysql_fetch_lengths(result.get()), field_count);
+        if (batch->rows == batch_rows) {
+          push_batch();
+          next_batch();
+        }
+      }
+      if (batch && batch->rows != 0) {
+        push_batch();
+      }
+    } catch (...) {
+      fail(std::current_exception());
+    }
+    fetch_done = true;
+    full_ready.notify();
+    for (auto &thread : consumers) {
+      thread.join();
+    }
+    // discards the rows left after a failure
+    result.reset();
+    if (failure) {
+      std::rethrow_exception(failure);
+    }
+    if (mysql_more_results(db)) {
+      throw exceptions::more_result_sets("no all result sets extracted", sql);
+    }
+  }
+
+  template <typename Function, size_t... Index>
+  static void _consume_row(Function &callback, const char *const *cells,
+                           const unsigned long *lengths,
+                           const MYSQL_FIELD *fields, const std::string &sql,
+                           std::index_sequence<Index...>) {
+    using traits = utility::function_traits<Function>;
+    std::tuple<std::remove_cv_t<std::remove_reference_t<
+        typename traits::template argument<Index>>>...>
+        values;
+    (_decode(static_cast<unsigned int>(Index), cells, lengths, fields, sql,
+             std::get<Index>(values)),
+     ...);
+    std::apply(callback, std::move(values));
+  }
+
+  template <typename Value>
+  static void _decode(unsigned int idx, const char *const *cells,
+                      const unsigned long *lengths, const MYSQL_FIELD *fields,
+                      const std::string &sql, Value &val) {
+    const auto status = type_converter<Value>::from_sql(
+        cells[idx], lengths[idx], fields[idx], val);
+    if (status != conversion_status::ok) {
+      throw_conversion_error(status, idx, fields[idx], sql);
+    }
+  }
+};
+
+} // namespace detail
+
+// Extracts the result of `stmt` like `stmt >> callback`,but overlaps the
+// network reads with decoding: the calling thread fetches rows unbuffered
+// with mysql_use_result and copies them in batches into a bounded ring,from
+// which options.consumers threads decode them and invoke the callback. Rows
+// are delivered in order when there is one consumer. The first exception
+// thrown by the fetch,a conversion or the callback stops the pipeline and is
+// rethrown.
+template <typename Policy, typename Function>
+void pipelined_extract(basic_statement_binder<Policy> &stmt,
+                       Function &&callback,
+                       const pipeline_options &options = {}) {
+  detail::pipeline_access::extract(stmt, callback, options);
+}
+
+template <typename Policy, typename Function>
+void pipelined_extract(basic_statement_binder<Policy> &&stmt,
+                       Function &&callback,
+                       const pipeline_options &options = {}) {
+  detail::pipeline_access::extract(stmt, callback, options);
+}
+
+} // namespace mariadb
@@ -0,0 +1,673 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "connection_handle.hpp"
+#include "errors.hpp"
+#include "statement_stats.hpp"
+#include "type_converter.hpp"
+#include "type_traits.hpp"
+#include "types.hpp"
+#include "utility/function_traits.hpp"
+
+namespace mariadb {
+
+constexpr std::size_t default_blob_chunk_size = 1024 * 1024;
+
+// fills at most `size` bytes of `buffer` and returns the number of bytes
+// written, 0 means the end of data
+using blob_reader =
+    std::function<std::size_t(std::byte *buffer, std::size_t size)>;
+// receives consecutive pieces of a blob
+using blob_writer =
+    std::function<void(const std::byte *data, std::size_t size)>;
+
+// binds a blob parameter whose content is pulled from `reader` chunk by chunk
+// by mysql_stmt_send_long_data, so it never has to be resident in memory.
+// An exception from `reader` fails the execution and discards the arguments.
+class blob_source {
+public:
+  explicit blob_source(blob_reader reader,
+                       std::size_t chunk_size = default_blob_chunk_size)
+      : _reader(std::move(reader)),
+        _chunk_size(std::max<std::size_t>(chunk_size, 1)) {}
+
+private:
+  friend class prepared_statement;
+  blob_reader _reader;
+  std::size_t _chunk_size;
+};
+
+// extracts a single blob value and pushes it into `writer` chunk by chunk
+class blob_sink {
+public:
+  explicit blob_sink(blob_writer writer,
+                     std::size_t chunk_size = default_blob_chunk_size)
+      : _writer(std::move(writer)),
+        _chunk_size(std::max<std::size_t>(chunk_size, 1)) {}
+
+private:
+  friend class prepared_statement;
+  blob_writer _writer;
+  std::size_t _chunk_size;
+};
+
+// a handle to a blob column of the current row,it is only valid inside the
+// callback receiving it
+class blob_column {
+public:
+  blob_column() = default;
+
+  std::size_t size() const noexcept { return _size; }
+
+  void read(const blob_writer &writer,
+            std::size_t chunk_size = default_blob_chunk_size) const {
+    std::vector<std::byte> chunk(
+        std::min(std::max<std::size_t>(chunk_size, 1), _size));
+    std::size_t offset = 0;
+    while (offset < _size) {
+      const auto piece = std::min(chunk.size(), _size - offset);
+      unsigned long length{};
+      MYSQL_BIND bind{};
+      bind.buffer_type = MYSQL_TYPE_BLOB;
+      bind.buffer = chunk.data();
+      bind.buffer_length = static_cast<unsigned long>(piece);
+      bind.length = &length;
+      if (mysql_stmt_fetch_column(_stmt, &bind, _idx,
+                                  static_cast<unsigned long>(offset)) != 0) {
+        throw mariadb_exception(_stmt);
+      }
+      writer(chunk.data(), piece);
+      offset += piece;
+    }
+  }
+
+private:
+  friend class prepared_statement;
+  MYSQL_STMT *_stmt{};
+  unsigned int _idx{};
+  std::size_t _size{};
+};
+
+// A statement using the binary protocol.
+// Unlike statement_binder,arguments are not spliced into the sql text,so
+// blobs can be streamed in both directions.
+class prepared_statement {
+
+public:
+  // prepared_statement is not copyable
+  prepared_statement() = delete;
+  prepared_statement(const prepared_statement &other) = delete;
+  prepared_statement &operator=(const prepared_statement &) = delete;
+  prepared_statement(prepared_statement &&) = default;
+
+  prepared_statement(connection_handle db, std::string sql)
+      : _db(db), _sql(std::move(sql)),
+        _stmt(mysql_stmt_init(_db.get()), [](MYSQL_STMT *ptr) noexcept {
+          mysql_stmt_close(ptr);
+        }) {
+    if (!_stmt) {
+      throw mariadb_exception(_db.get(), _sql);
+    }
+    if (mysql_stmt_prepare(_stmt.get(), _sql.c_str(), _sql.size()) != 0) {
+      throw mariadb_exception(_stmt.get(), _sql);
+    }
+    const auto param_count = mysql_stmt_param_count(_stmt.get());
+    _params.resize(param_count);
+    _param_values.resize(param_count);
+  }
+
+  ~prepared_statement() noexcept(false) {
+    if (_stmt && !used() && std::uncaught_exceptions() == 0) {
+      execute();
+    }
+  }
+
+  void execute() {
+    used(true);
+
+    if (_bound_count != _params.size()) {
+      throw exceptions::lack_prepare_arguments(
+          "lacks some arguments to prepare sql", _sql);
+    }
+
+    if (!_params.empty() &&
+        mysql_stmt_bind_param(_stmt.get(), _params.data()) != 0) {
+      throw mariadb_exception(_stmt.get(), _sql);
+    }
+
+    try {
+      for (size_t i = 0; i < _param_values.size(); i++) {
+        if (_param_values[i].source) {
+          _send_long_data(static_cast<unsigned int>(i),
+                          *_param_values[i].source);
+        }
+      }
+    } catch (...) {
+      // the data sent so far would be prepended to the next execution
+      mysql_stmt_reset(_stmt.get());
+      _reset();
+      throw;
+    }
+
+    const bool timed = statement_stats::enabled();
+    const auto start = timed ? std::chrono::steady_clock::now()
+                             : std::chrono::steady_clock::time_point{};
+    const auto res = mysql_stmt_execute(_stmt.get());
+    if (timed) {
+      statement_stats::record(digest(), _sql,
+                              std::chrono::steady_clock::now() - start, 0,
+                              res != 0);
+    }
+    if (res != 0) {
+      _reset();
+      throw mariadb_exception(_stmt.get(), _sql);
+    }
+    _reset();
+  }
+
+  std::string sql() { return _sql; }
+
+  // see sql_digest()
+  uint64_t digest() const noexcept {
+    if (_digest == 0) {
+      _digest = sql_digest(_sql);
+    }
+    return _digest;
+  }
+
+  void used(bool state) noexcept {
+    if (state) {
+      mysql_stmt_free_result(_stmt.get());
+    }
+    execution_started = state;
+  }
+  bool used() const noexcept { return execution_started; }
+
+  // discards the pending result and the bound arguments so that the
+  // statement can be executed again
+  void reuse() noexcept {
+    used(true);
+    _reset();
+    used(false);
+  }
+
+  my_ulonglong affected_rows() const noexcept {
+    return mysql_stmt_affected_rows(_stmt.get());
+  }
+
+  template <typename Result>
+  typename std::enable_if<is_mariadb_value<Result>::value, void>::type
+  operator>>(Result &value) {
+    this->_extract_single_value(
+        [&value, this] { _get_col_from_row(0, value); });
+  }
+
+  void operator>>(blob_sink sink) {
+    this->_extract_single_value([&sink, this] {
+      blob_column column;
+      _get_col_from_row(0, column);
+      column.read(sink._writer, sink._chunk_size);
+    });
+  }
+
+  template <typename... Types> void operator>>(std::tuple<Types...> &&values) {
+    this->_extract_single_value([&values, this]() {
+      std::apply(
+          [this](auto &... elements) {
+            unsigned int idx = 0;
+            (_get_col_from_row(idx++, elements), ...);
+          },
+          values);
+    });
+  }
+
+  template <std::size_t Count> class binder {
+  private:
+    template <typename Function, std::size_t Index>
+    using nth_argument_type =
+        typename utility::function_traits<Function>::template argument<Index>;
+
+  public:
+    template <typename Function, typename... Values,
+              std::size_t Boundary = Count>
+    static typename std::enable_if<(sizeof...(Values) < Boundary), void>::type
+    run(prepared_statement &db, Function &&function, Values &&... values) {
+      typename std::remove_cv<typename std::remove_reference<
+          nth_argument_type<Function, sizeof...(Values)>>::type>::type value{};
+      db._get_col_from_row(sizeof...(Values), value);
+
+      run<Function>(db, function, std::forward<Values>(values)...,
+                    std::move(value));
+    }
+
+    template <typename Function, typename... Values,
+              std::size_t Boundary = Count>
+    static typename std::enable_if<(sizeof...(Values) == Boundary), void>::type
+    run(prepared_statement &, Function &&function, Values &&... values) {
+      function(std::move(values)...);
+    }
+  };
+
+  template <typename Function>
+  typename std::enable_if<!is_mariadb_value<Function>::value, void>::type
+  operator>>(Function &&func) {
+    typedef utility::function_traits<Function> traits;
+
+    this->_extract(
+        [&func, this]() { binder<traits::arity>::run(*this, func); });
+  }
+
+  template <std::size_t N>
+  prepared_statement &operator<<(const char (&STR)[N]) {
+    auto &value = _next_param();
+    value.bytes.assign(STR, N - 1);
+    return _bind_bytes(MYSQL_TYPE_STRING);
+  }
+
+  prepared_statement &operator<<(blob_source source) {
+    auto &value = _next_param();
+    value.source = std::make_unique<blob_source>(std::move(source));
+    return _bind_bytes(MYSQL_TYPE_LONG_BLOB);
+  }
+
+  template <typename Argument>
+  typename std::enable_if<
+      is_mariadb_value<typename std::remove_cv<
+          typename std::remove_reference<Argument>::type>::type>::value,
+      prepared_statement &>::type
+  operator<<(Argument &&val) {
+    using raw_argument_type = typename std::remove_cv<
+        typename std::remove_reference<Argument>::type>::type;
+
+    if constexpr (is_specialization_of<raw_argument_type,
+                                       std::optional>::value) {
+      if (val.has_value()) {
+        return (*this) << (*val);
+      }
+      return _bind_null();
+    } else if constexpr (is_specialization_of<raw_argument_type,
+                                              std::unique_ptr>::value) {
+      if (val.get()) {
+        return (*this) << (*val);
+      }
+      return _bind_null();
+    } else {
+      auto &value = _next_param();
+      auto &bind = _params[_bound_count];
+      if constexpr (std::is_same_v<raw_argument_type, std::string>) {
+        value.bytes = val;
+        return _bind_bytes(MYSQL_TYPE_STRING);
+      } else if constexpr (is_specialization_of<raw_argument_type,
+                                                std::vector>::value) {
+        value.bytes.assign(
+            reinterpret_cast<const char *>(val.data()),
+            val.size() * sizeof(typename raw_argument_type::value_type));
+        return _bind_bytes(MYSQL_TYPE_BLOB);
+      } else if constexpr (detail::is_temporal<raw_argument_type>::value) {
+        value.time = detail::to_mysql_time(val);
+        bind.buffer_type = value.time.time_type == MYSQL_TIMESTAMP_TIME
+                               ? MYSQL_TYPE_TIME
+                               : value.time.time_type == MYSQL_TIMESTAMP_DATE
+                                     ? MYSQL_TYPE_DATE
+                                     : MYSQL_TYPE_DATETIME;
+        bind.buffer = &value.time;
+      } else if constexpr (std::is_same_v<raw_argument_type, decimal>) {
+        char buffer[decimal::max_chars];
+        value.bytes.assign(buffer, val.to_chars(buffer));
+        return _bind_bytes(MYSQL_TYPE_NEWDECIMAL);
+      } else if constexpr (is_bitset<raw_argument_type>::value) {
+        detail::bitset_to_bytes(val, value.bytes);
+        return _bind_bytes(MYSQL_TYPE_BLOB);
+      } else if constexpr (std::is_integral_v<raw_argument_type>) {
+        if constexpr (std::is_unsigned_v<raw_argument_type>) {
+          value.number.u = val;
+          bind.is_unsigned = 1;
+        } else {
+          value.number.i = val;
+        }
+        bind.buffer_type = MYSQL_TYPE_LONGLONG;
+        bind.buffer = &value.number;
+      } else if constexpr (std::is_floating_point_v<raw_argument_type>) {
+        value.number.d = static_cast<double>(val);
+        bind.buffer_type = MYSQL_TYPE_DOUBLE;
+        bind.buffer = &value.number;
+      } else {
+        static_assert(sizeof(raw_argument_type) == 0,
+                      "types with a user type_converter can only be bound by "
+                      "statement_binder");
+      }
+      _bound_count++;
+      return *this;
+    }
+  }
+
+private:
+  struct param_value {
+    union {
+      long long i;
+      unsigned long long u;
+      double d;
+    } number{};
+    MYSQL_TIME time{};
+    std::string bytes;
+    unsigned long length{};
+    my_bool is_null{};
+    std::unique_ptr<blob_source> source;
+  };
+
+  connection_handle _db;
+  std::string _sql;
+  std::unique_ptr<MYSQL_STMT, void (*)(MYSQL_STMT *)> _stmt;
+  std::vector<MYSQL_BIND> _params;
+  std::vector<param_value> _param_values;
+  size_t _bound_count{};
+
+  std::vector<MYSQL_BIND> _results;
+  std::vector<unsigned long> _lengths;
+  std::vector<my_bool> _nulls;
+  std::vector<MYSQL_FIELD> _field_storage;
+  std::string _text_buffer;
+  MYSQL_FIELD *fields{};
+  unsigned int field_count{};
+
+  bool execution_started = false;
+  mutable uint64_t _digest{0};
+
+  void _reset() {
+    for (auto &value : _param_values) {
+      value = param_value{};
+    }
+    for (auto &bind : _params) {
+      bind = MYSQL_BIND{};
+    }
+    _bound_count = 0;
+  }
+
+  param_value &_next_param() {
+    if (_bound_count >= _params.size()) {
+      throw exceptions::more_prepare_arguments(
+          "no extra arguments needed to prepare sql", _sql);
+    }
+    return _param_values[_bound_count];
+  }
+
+  prepared_statement &_bind_bytes(enum_field_types type) {
+    auto &value = _param_values[_bound_count];
+    auto &bind = _params[_bound_count];
+    value.length = static_cast<unsigned long>(value.bytes.size());
+    bind.buffer_type = type;
+    bind.buffer = value.bytes.data();
+    bind.buffer_length = value.length;
+    bind.length = &value.length;
+    _bound_count++;
+    return *this;
+  }
+
+  prepared_statement &_bind_null() {
+    auto &value = _next_param();
+    auto &bind = _params[_bound_count];
+    value.is_null = 1;
+    bind.buffer_type = MYSQL_TYPE_NULL;
+    bind.is_null = &value.is_null;
+    _bound_count++;
+    return *this;
+  }
+
+  void _send_long_data(unsigned int idx, blob_source &source) {
+    std::vector<std::byte> chunk(source._chunk_size);
+    while (true) {
+      const auto size = source._reader(chunk.data(), chunk.size());
+      if (size == 0) {
+        break;
+      }
+      if (size > chunk.size()) {
+        throw mariadb_exception("blob_reader returned more than requested",
+                                _sql);
+      }
+      if (mysql_stmt_send_long_data(
+              _stmt.get(), idx, reinterpret_cast<const char *>(chunk.data()),
+              static_cast<unsigned long>(size)) != 0) {
+        throw mariadb_exception(_stmt.get(), _sql);
+      }
+    }
+  }
+
+  // rows are fetched unbuffered and every column is bound with an empty
+  // buffer,so only their lengths are known after mysql_stmt_fetch and the
+  // values are copied out by mysql_stmt_fetch_column on demand
+  void _bind_result() {
+    auto metadata = std::unique_ptr<MYSQL_RES, void (*)(MYSQL_RES *)>(
+        mysql_stmt_result_metadata(_stmt.get()),
+        [](MYSQL_RES *ptr) noexcept { mysql_free_result(ptr); });
+    if (!metadata) {
+      throw exceptions::no_result_sets(
+          "no result sets to extract: exactly 1 result set expected", sql());
+    }
+    fields = mysql_fetch_fields(metadata.get());
+    field_count = mysql_num_fields(metadata.get());
+    _field_storage.assign(fields, fields + field_count);
+    fields = _field_storage.data();
+
+    _results.assign(field_count, MYSQL_BIND{});
+    _lengths.assign(field_count, 0);
+    _nulls.assign(field_count, 0);
+    for (unsigned int i = 0; i < field_count; i++) {
+      _results[i].buffer_type = MYSQL_TYPE_STRING;
+      _results[i].length = &_lengths[i];
+      _results[i].is_null = &_nulls[i];
+    }
+    if (mysql_stmt_bind_result(_stmt.get(), _results.data()) != 0) {
+      throw mariadb_exception(_stmt.get(), _sql);
+    }
+  }
+
+  bool _fetch() {
+    const auto res = mysql_stmt_fetch(_stmt.get());
+    if (res == MYSQL_NO_DATA) {
+      return false;
+    }
+    if (res != 0 && res != MYSQL_DATA_TRUNCATED) {
+      throw mariadb_exception(_stmt.get(), _sql);
+    }
+    return true;
+  }
+
+  void _extract(std::function<void(void)> call_back) {
+    if (!used()) {
+      execute();
+    }
+    _bind_result();
+
+    uint64_t rows = 0;
+    while (_fetch()) {
+      call_back();
+      rows++;
+    }
+    used(true);
+    if (statement_stats::enabled()) {
+      statement_stats::record(digest(), _sql, {}, rows, false, false);
+    }
+  }
+
+  void _extract_single_value(std::function<void(void)> call_back) {
+    if (!used()) {
+      execute();
+    }
+    _bind_result();
+
+    if (!_fetch()) {
+      throw exceptions::no_rows("no rows to extract: exactly 1 row expected",
+                                sql());
+    }
+    call_back();
+    if (_fetch()) {
+      used(true);
+      throw exceptions::more_rows("not all rows extracted", sql());
+    }
+    used(true);
+  }
+
+  void _fetch_column(unsigned int idx, enum_field_types type, void *buffer,
+                     unsigned long buffer_length, bool is_unsigned = false) {
+    my_bool error{};
+    unsigned long length{};
+    MYSQL_BIND bind{};
+    bind.buffer_type = type;
+    bind.buffer = buffer;
+    bind.buffer_length = buffer_length;
+    bind.length = &length;
+    bind.error = &error;
+    bind.is_unsigned = is_unsigned;
+    if (mysql_stmt_fetch_column(_stmt.get(), &bind, idx, 0) != 0) {
+      throw mariadb_exception(_stmt.get(), _sql);
+    }
+    if (error) {
+      throw exceptions::column_conversion(
+          std::string("converting column ") + std::to_string(idx) +
+              " failed",
+          sql());
+    }
+  }
+
+  template <typename Result>
+  void _get_col_from_row(unsigned int idx, Result &val) {
+
+    if (idx >= field_count) {
+      throw exceptions::out_of_row_range(
+          std::string("try to access column ") + std::to_string(idx) +
+              " ,exceeds column count " + std::to_string(field_count),
+          sql());
+    }
+
+    if constexpr (is_specialization_of<Result, std::optional>::value) {
+      if (_nulls[idx]) {
+        val.reset();
+      } else {
+        typename Result::value_type real_value{};
+        _get_col_from_row(idx, real_value);
+        val = std::move(real_value);
+      }
+      return;
+    } else if constexpr (is_specialization_of<Result, std::unique_ptr>::value) {
+      if (_nulls[idx]) {
+        val.reset();
+      } else {
+        typename Result::element_type real_value{};
+        _get_col_from_row(idx, real_value);
+        val = std::make_unique<typename Result::element_type>(
+            std::move(real_value));
+      }
+      return;
+    } else if (_nulls[idx]) {
+      throw exceptions::can_not_hold_null(
+          std::string("column ") + std::to_string(idx) +
+              " can be NULL,can't be stored in "
+              "argument type,try std::optional",
+          sql());
+    }
+
+    if constexpr (std::is_same_v<Result, blob_column>) {
+      val._stmt = _stmt.get();
+      val._idx = idx;
+      val._size = _lengths[idx];
+    } else if constexpr (std::is_same_v<Result, std::string>) {
+      val.resize(_lengths[idx]);
+      _fetch_column(idx, MYSQL_TYPE_STRING, val.data(), _lengths[idx]);
+    } else if constexpr (is_specialization_of<Result, std::vector>::value) {
+      if (_lengths[idx] % sizeof(typename Result::value_type) != 0) {
+        throw exceptions::bad_alignment(
+            std::string("column ") + std::to_string(idx) + " type " +
+                std::to_string(fields[idx].type) +
+                " can't be stored in argument",
+            sql());
+      }
+      val.resize(_lengths[idx] / sizeof(typename Result::value_type));
+      _fetch_column(idx, MYSQL_TYPE_BLOB, val.data(), _lengths[idx]);
+    } else if constexpr (detail::is_temporal<Result>::value) {
+      // the connector converts the column to the requested MYSQL_TIME kind
+      MYSQL_TIME time{};
+      enum_field_types type = MYSQL_TYPE_DATETIME;
+      if constexpr (is_duration<Result>::value) {
+        type = MYSQL_TYPE_TIME;
+      }
+      _fetch_column(idx, type, &time, sizeof(time));
+      if (!detail::from_mysql_time(time, val)) {
+        throw exceptions::column_conversion(
+            std::string("converting column ") + std::to_string(idx) +
+                " to time failed",
+            sql());
+      }
+    } else if constexpr (std::is_same_v<Result, decimal>) {
+      char buffer[decimal::max_chars + 1]{};
+      if (_lengths[idx] > decimal::max_chars) {
+        throw exceptions::column_conversion(
+            std::string("column ") + std::to_string(idx) +
+                " has too many digits for decimal",
+            sql());
+      }
+      _fetch_column(idx, MYSQL_TYPE_STRING, buffer, sizeof(buffer));
+      if (!decimal::from_chars(buffer, buffer + _lengths[idx], val)) {
+        throw exceptions::column_conversion(
+            std::string("converting column ") + std::to_string(idx) +
+                " to decimal failed",
+            sql());
+      }
+    } else if constexpr (is_bitset<Result>::value) {
+      char buffer[(Result().size() + 7) / 8 + 8]{};
+      if (_lengths[idx] > sizeof(buffer)) {
+        throw exceptions::column_conversion(
+            std::string("column ") + std::to_string(idx) +
+                " has too many bits for bitset",
+            sql());
+      }
+      _fetch_column(idx, MYSQL_TYPE_BLOB, buffer, sizeof(buffer));
+      if (!detail::bitset_from_bytes(buffer, _lengths[idx], val)) {
+        throw exceptions::column_conversion(
+            std::string("converting column ") + std::to_string(idx) +
+                " to bitset failed",
+            sql());
+      }
+    } else if constexpr (std::is_integral_v<Result>) {
+      if constexpr (std::is_unsigned_v<Result>) {
+        unsigned long long real_value{};
+        _fetch_column(idx, MYSQL_TYPE_LONGLONG, &real_value,
+                      sizeof(real_value), true);
+        val = static_cast<Result>(real_value);
+      } else {
+        long long real_value{};
+        _fetch_column(idx, MYSQL_TYPE_LONGLONG, &real_value,
+                      sizeof(real_value));
+        val = static_cast<Result>(real_value);
+      }
+    } else if constexpr (std::is_floating_point_v<Result>) {
+      double real_value{};
+      _fetch_column(idx, MYSQL_TYPE_DOUBLE, &real_value, sizeof(real_value));
+      val = static_cast<Result>(real_value);
+    } else {
+      // other types get the column as text like in statement_binder
+      _text_buffer.resize(_lengths[idx]);
+      _fetch_column(idx, MYSQL_TYPE_STRING, _text_buffer.data(),
+                    _lengths[idx]);
+      if (type_converter<Result>::from_sql(_text_buffer.data(),
+                                           _text_buffer.size(), fields[idx],
+                                           val) != conversion_status::ok) {
+        throw exceptions::column_conversion(
+            std::string("converting column ") + std::to_string(idx) +
+                " failed",
+            sql());
+      }
+    }
+  }
+};
+
+} // namespace mariadb
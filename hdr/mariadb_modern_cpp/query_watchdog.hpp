@@ -0,0 +1,153 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace mariadb {
+
+// Kills the queries outliving their deadline from a thread of its own.
+// `kill` receives the connection id of the query,e.g. to run
+// KILL QUERY on another connection,so the connection of the query is
+// left usable.
+class query_watchdog {
+public:
+  using clock = std::chrono::steady_clock;
+  using kill_function = std::function<void(unsigned long connection_id)>;
+
+  // disarms the deadline on destruction
+  class guard {
+  public:
+    guard() noexcept = default;
+    guard(const guard &) = delete;
+    guard &operator=(const guard &) = delete;
+    guard(guard &&other) noexcept
+        : _watchdog(other._watchdog), _id(other._id) {
+      other._watchdog = nullptr;
+    }
+    guard &operator=(guard &&other) noexcept {
+      if (this != &other) {
+        disarm();
+        _watchdog = other._watchdog;
+        _id = other._id;
+        other._watchdog = nullptr;
+      }
+      return *this;
+    }
+    ~guard() { disarm(); }
+
+    // returns after a kill of the query in progress,if any,is done
+    void disarm() noexcept {
+      if (_watchdog) {
+        _watchdog->_disarm(_id);
+        _watchdog = nullptr;
+      }
+    }
+
+  private:
+    friend class query_watchdog;
+    guard(query_watchdog *watchdog, uint64_t id) noexcept
+        : _watchdog(watchdog), _id(id) {}
+
+    query_watchdog *_watchdog{};
+    uint64_t _id{};
+  };
+
+  explicit query_watchdog(kill_function kill)
+      : _kill(std::move(kill)), _thread([this] { _loop(); }) {}
+
+  query_watchdog(const query_watchdog &) = delete;
+  query_watchdog &operator=(const query_watchdog &) = delete;
+
+  ~query_watchdog() {
+    {
+      std::lock_guard lk(_mtx);
+      _stop = true;
+    }
+    _cv.notify_all();
+    _thread.join();
+  }
+
+  guard arm(clock::time_point deadline, unsigned long connection_id) {
+    uint64_t id{};
+    {
+      std::lock_guard lk(_mtx);
+      id = _next_id++;
+      _entries.emplace(id, entry{deadline, connection_id});
+    }
+    _cv.notify_all();
+    return guard(this, id);
+  }
+
+  // the number of queries killed
+  uint64_t kills() const noexcept {
+    return _kills.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct entry {
+    clock::time_point deadline;
+    unsigned long connection_id;
+  };
+
+  void _disarm(uint64_t id) noexcept {
+    std::unique_lock lk(_mtx);
+    _entries.erase(id);
+    // the query must not move on to another statement before its kill
+    // arrives,or that statement would be killed instead
+    _killed_cv.wait(lk, [this, id] { return _killing != id; });
+  }
+
+  void _loop() {
+    std::unique_lock lk(_mtx);
+    while (!_stop) {
+      // few statements run at once,so a scan is cheaper than an index
+      auto next = _entries.end();
+      for (auto it = _entries.begin(); it != _entries.end(); ++it) {
+        if (next == _entries.end() ||
+            it->second.deadline < next->second.deadline) {
+          next = it;
+        }
+      }
+      if (next == _entries.end()) {
+        _cv.wait(lk);
+        continue;
+      }
+      if (next->second.deadline > clock::now()) {
+        _cv.wait_until(lk, next->second.deadline);
+        continue;
+      }
+      const auto id = next->first;
+      const auto connection_id = next->second.connection_id;
+      _entries.erase(next);
+      _killing = id;
+      lk.unlock();
+      try {
+        _kill(connection_id);
+        _kills.fetch_add(1, std::memory_order_relaxed);
+      } catch (...) {
+      }
+      lk.lock();
+      _killing = 0;
+      _killed_cv.notify_all();
+    }
+  }
+
+  kill_function _kill;
+  std::mutex _mtx;
+  std::condition_variable _cv;
+  std::condition_variable _killed_cv;
+  std::map<uint64_t, entry> _entries;
+  uint64_t _next_id{1};
+  uint64_t _killing{0};
+  bool _stop{false};
+  std::atomic<uint64_t> _kills{0};
+  std::thread _thread;
+};
+
+} // namespace mariadb
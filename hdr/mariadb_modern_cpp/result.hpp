@@ -0,0 +1,245 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+
+#include "errors.hpp"
+
+namespace mariadb {
+
+enum class error_kind : unsigned char {
+  // reported by the connector or the server
+  server,
+  lack_prepare_arguments,
+  more_prepare_arguments,
+  no_result_sets,
+  more_result_sets,
+  no_rows,
+  more_rows,
+  out_of_row_range,
+  unsupported_column_type,
+  column_conversion,
+  can_not_hold_null,
+  bad_alignment,
+  // a server error aborting a statement with a deadline
+  deadline_exceeded,
+  // rejected by an admission_controller,`detail` is an admission_rejection
+  overloaded,
+};
+
+// The error of a statement returned instead of thrown. It doesn't allocate,
+// the message is only formatted when asked for. Only the bytes of a server
+// message are written and copied,the rest of the buffer is left
+// uninitialized.
+class error {
+public:
+  static constexpr size_t max_text_size = 512;
+
+  error(unsigned int code, std::string_view sqlstate,
+        std::string_view text) noexcept
+      : _kind(error_kind::server), _code(code),
+        _text_size(static_cast<unsigned short>(
+            std::min(text.size(), max_text_size))) {
+    _copy(sqlstate, _sqlstate, sizeof(_sqlstate));
+    if (_text_size > 0) {
+      std::memcpy(_text, text.data(), _text_size);
+    }
+  }
+
+  // an error detected by this library,`column` and `detail` are the column
+  // index and its type or the column count
+  explicit error(error_kind kind, unsigned int column = 0,
+                 unsigned int detail = 0) noexcept
+      : _kind(kind),
+        _code(kind == error_kind::lack_prepare_arguments ? CR_PARAMS_NOT_BOUND
+                                                         : CR_UNKNOWN_ERROR),
+        _column(column), _detail(detail) {
+    _copy("HY000", _sqlstate, sizeof(_sqlstate));
+  }
+
+  error(const error &other) noexcept
+      : _kind(other._kind), _code(other._code), _column(other._column),
+        _detail(other._detail), _text_size(other._text_size) {
+    std::memcpy(_sqlstate, other._sqlstate, sizeof(_sqlstate));
+    std::memcpy(_text, other._text, _text_size);
+  }
+  error &operator=(const error &other) noexcept {
+    if (this != &other) {
+      _kind = other._kind;
+      _code = other._code;
+      _column = other._column;
+      _detail = other._detail;
+      _text_size = other._text_size;
+      std::memcpy(_sqlstate, other._sqlstate, sizeof(_sqlstate));
+      std::memcpy(_text, other._text, _text_size);
+    }
+    return *this;
+  }
+
+  static error from(MYSQL *mysql) noexcept {
+    return error(mysql_errno(mysql), mysql_sqlstate(mysql), mysql_error(mysql));
+  }
+  static error from(MYSQL_STMT *stmt) noexcept {
+    return error(mysql_stmt_errno(stmt), mysql_stmt_sqlstate(stmt),
+                 mysql_stmt_error(stmt));
+  }
+
+  error_kind kind() const noexcept { return _kind; }
+  // the same error reported as another kind
+  error with_kind(error_kind kind) const noexcept {
+    auto e = *this;
+    e._kind = kind;
+    return e;
+  }
+  unsigned int code() const noexcept { return _code; }
+  std::string_view sqlstate() const noexcept { return _sqlstate; }
+
+  std::string message() const {
+    const auto column = std::to_string(_column);
+    const auto detail = std::to_string(_detail);
+    switch (_kind) {
+    case error_kind::server:
+    case error_kind::deadline_exceeded:
+      return std::string(_text, _text_size);
+    case error_kind::lack_prepare_arguments:
+      return "lacks some arguments to prepare sql";
+    case error_kind::more_prepare_arguments:
+      return "no extra arguments needed to prepare sql";
+    case error_kind::no_result_sets:
+      return "no result sets to extract: exactly 1 result set expected";
+    case error_kind::more_result_sets:
+      return "no all result sets extracted";
+    case error_kind::no_rows:
+      return "no rows to extract: exactly 1 row expected";
+    case error_kind::more_rows:
+      return "not all rows extracted";
+    case error_kind::out_of_row_range:
+      return "try to access column " + column + " ,exceeds column count " +
+             detail;
+    case error_kind::unsupported_column_type:
+      return "column " + column + " type " + detail + " is not supported";
+    case error_kind::column_conversion:
+      return "converting column " + column + " failed";
+    case error_kind::can_not_hold_null:
+      return "column " + column +
+             " can be NULL,can't be stored in argument type,try std::optional";
+    case error_kind::bad_alignment:
+      return "column " + column + " type " + detail +
+             " can't be stored in argument";
+    case error_kind::overloaded:
+      return _detail == 0 ? "rejected by admission control: queue full"
+                          : "rejected by admission control: queue timeout";
+    }
+    return std::string(_text, _text_size);
+  }
+
+  // throws the exception class matching the kind
+  [[noreturn]] void raise(std::string sql = "") const {
+    switch (_kind) {
+    case error_kind::server:
+      throw mariadb_exception(_code, message(), std::move(sql));
+    case error_kind::lack_prepare_arguments:
+      throw exceptions::lack_prepare_arguments(_code, message(),
+                                               std::move(sql));
+    case error_kind::more_prepare_arguments:
+      throw exceptions::more_prepare_arguments(_code, message(),
+                                               std::move(sql));
+    case error_kind::no_result_sets:
+      throw exceptions::no_result_sets(_code, message(), std::move(sql));
+    case error_kind::more_result_sets:
+      throw exceptions::more_result_sets(_code, message(), std::move(sql));
+    case error_kind::no_rows:
+      throw exceptions::no_rows(_code, message(), std::move(sql));
+    case error_kind::more_rows:
+      throw exceptions::more_rows(_code, message(), std::move(sql));
+    case error_kind::out_of_row_range:
+      throw exceptions::out_of_row_range(_code, message(), std::move(sql));
+    case error_kind::unsupported_column_type:
+      throw exceptions::unsupported_column_type(_code, message(),
+                                                std::move(sql));
+    case error_kind::column_conversion:
+      throw exceptions::column_conversion(_code, message(), std::move(sql));
+    case error_kind::can_not_hold_null:
+      throw exceptions::can_not_hold_null(_code, message(), std::move(sql));
+    case error_kind::bad_alignment:
+      throw exceptions::bad_alignment(_code, message(), std::move(sql));
+    case error_kind::deadline_exceeded:
+      throw exceptions::deadline_exceeded(_code, message(), std::move(sql));
+    case error_kind::overloaded:
+      throw exceptions::overloaded(_code, message(), std::move(sql));
+    }
+    throw mariadb_exception(_code, message(), std::move(sql));
+  }
+
+private:
+  static void _copy(std::string_view from, char *to, size_t size) noexcept {
+    const auto n = std::min(from.size(), size - 1);
+    std::memcpy(to, from.data(), n);
+    to[n] = '\0';
+  }
+
+  error_kind _kind;
+  unsigned int _code;
+  unsigned int _column{};
+  unsigned int _detail{};
+  unsigned short _text_size{};
+  char _sqlstate[6]{};
+  // only the first _text_size bytes are set
+  char _text[max_text_size];
+};
+
+// Holds a value or an error,like std::expected
+template <typename T> class result {
+public:
+  result(T value) : _storage(std::in_place_index<0>, std::move(value)) {}
+  result(mariadb::error e) : _storage(std::in_place_index<1>, std::move(e)) {}
+
+  bool has_value() const noexcept { return _storage.index() == 0; }
+  explicit operator bool() const noexcept { return has_value(); }
+
+  // throws the error if there is no value
+  T &value() & {
+    if (!has_value()) {
+      error().raise();
+    }
+    return std::get<0>(_storage);
+  }
+  T &&value() && { return std::move(value()); }
+  T &operator*() noexcept { return *std::get_if<0>(&_storage); }
+  T *operator->() noexcept { return std::get_if<0>(&_storage); }
+
+  const mariadb::error &error() const noexcept {
+    return *std::get_if<1>(&_storage);
+  }
+
+private:
+  std::variant<T, mariadb::error> _storage;
+};
+
+template <> class result<void> {
+public:
+  result() = default;
+  result(mariadb::error e) : _error(std::move(e)) {}
+
+  bool has_value() const noexcept { return !_error.has_value(); }
+  explicit operator bool() const noexcept { return has_value(); }
+
+  // throws the error if there is one
+  void value() const {
+    if (_error) {
+      _error->raise();
+    }
+  }
+
+  const mariadb::error &error() const noexcept { return *_error; }
+
+private:
+  std::optional<mariadb::error> _error;
+};
+
+} // namespace mariadb
@@ -0,0 +1,495 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../mariadb_modern_cpp.hpp"
+
+namespace mariadb {
+
+/*
+  A result set saved by save_snapshot(). All integers are in the byte order
+  of the writer and every section starts at a multiple of 8:
+
+  header   magic "MDBSNAP",version,byte order mark,column count,sql size,
+           row count,group count,index offset,then the sql
+  columns  type,flags,charsetnr,decimals,length,name size,name with '\0'
+  groups   row count,then for each column a null bitmap,row count + 1
+           offsets and the values
+  index    the offset of each group
+*/
+constexpr uint32_t snapshot_format_version = 1;
+
+namespace detail {
+
+constexpr char snapshot_magic[8] = "MDBSNAP";
+constexpr uint32_t snapshot_byte_order = 0x01020304;
+constexpr size_t snapshot_header_size = 48;
+
+inline size_t snapshot_padding(size_t size) noexcept {
+  return (8 - size % 8) % 8;
+}
+
+class snapshot_writer {
+public:
+  snapshot_writer(const std::string &path, const MYSQL_FIELD *fields,
+                  unsigned int field_count, const std::string &sql,
+                  size_t group_rows)
+      : _path(path), _file(std::fopen(path.c_str(), "wb"), std::fclose),
+        _columns(field_count), _group_rows(std::max<size_t>(group_rows, 1)) {
+    if (!_file) {
+      _fail();
+    }
+    char header[snapshot_header_size]{};
+    std::memcpy(header, snapshot_magic, sizeof(snapshot_magic));
+    _put(header, 8, snapshot_format_version);
+    _put(header, 12, snapshot_byte_order);
+    _put(header, 16, static_cast<uint32_t>(field_count));
+    _put(header, 20, static_cast<uint32_t>(sql.size()));
+    _write(header, sizeof(header));
+    _write_padded(sql.data(), sql.size());
+    for (unsigned int i = 0; i < field_count; i++) {
+      const auto &field = fields[i];
+      char column[32]{};
+      const auto name_size = static_cast<uint32_t>(field.name_length);
+      _put(column, 0, static_cast<uint32_t>(field.type));
+      _put(column, 4, static_cast<uint32_t>(field.flags));
+      _put(column, 8, static_cast<uint32_t>(field.charsetnr));
+      _put(column, 12, static_cast<uint32_t>(field.decimals));
+      _put(column, 16, static_cast<uint64_t>(field.length));
+      _put(column, 24, name_size);
+      _write(column, sizeof(column));
+      std::string name(field.name ? field.name : "", name_size);
+      _write_padded(name.c_str(), name.size() + 1);
+    }
+    _reset_group();
+  }
+
+  void add_row(const char *const *cells, const unsigned long *lengths) {
+    for (size_t i = 0; i < _columns.size(); i++) {
+      auto &column = _columns[i];
+      if (_group_size % 8 == 0) {
+        column.nulls.push_back(0);
+      }
+      if (cells[i]) {
+        column.data.append(cells[i], lengths[i]);
+      } else {
+        column.nulls.back() |= static_cast<uint8_t>(1 << (_group_size % 8));
+      }
+      column.offsets.push_back(column.data.size());
+      _group_bytes += cells[i] ? lengths[i] : 0;
+    }
+    _group_size++;
+    _row_count++;
+    // groups are also cut by size so that wide rows don't buffer much
+    if (_group_size == _group_rows || _group_bytes >= (64 << 20)) {
+      _flush_group();
+    }
+  }
+
+  void finish() {
+    _flush_group();
+    const auto index_offset = _offset;
+    for (auto offset : _group_offsets) {
+      _write(&offset, sizeof(offset));
+    }
+    char counts[24]{};
+    _put(counts, 0, _row_count);
+    _put(counts, 8, static_cast<uint64_t>(_group_offsets.size()));
+    _put(counts, 16, static_cast<uint64_t>(index_offset));
+    if (std::fseek(_file.get(), 24, SEEK_SET) != 0) {
+      _fail();
+    }
+    _write(counts, sizeof(counts));
+    if (std::fflush(_file.get()) != 0 || ::fsync(::fileno(_file.get())) != 0) {
+      _fail();
+    }
+  }
+
+private:
+  struct column_buffer {
+    std::vector<uint8_t> nulls;
+    std::vector<uint64_t> offsets;
+    std::string data;
+  };
+
+  template <typename Integer>
+  static void _put(char *buffer, size_t offset, Integer value) noexcept {
+    std::memcpy(buffer + offset, &value, sizeof(value));
+  }
+
+  [[noreturn]] void _fail() const {
+    throw mariadb_exception("writing snapshot " + _path + " failed: " +
+                            std::strerror(errno));
+  }
+
+  void _write(const void *data, size_t size) {
+    if (size != 0 && std::fwrite(data, 1, size, _file.get()) != size) {
+      _fail();
+    }
+    _offset += size;
+  }
+
+  void _write_padded(const void *data, size_t size) {
+    static const char zeros[8]{};
+    _write(data, size);
+    _write(zeros, snapshot_padding(size));
+  }
+
+  void _reset_group() {
+    for (auto &column : _columns) {
+      column.nulls.clear();
+      column.offsets.assign(1, 0);
+      column.data.clear();
+    }
+    _group_size = 0;
+    _group_bytes = 0;
+  }
+
+  void _flush_group() {
+    if (_group_size == 0) {
+      return;
+    }
+    _group_offsets.push_back(_offset);
+    const uint64_t rows = _group_size;
+    _write(&rows, sizeof(rows));
+    for (const auto &column : _columns) {
+      _write_padded(column.nulls.data(), column.nulls.size());
+      _write(column.offsets.data(), column.offsets.size() * sizeof(uint64_t));
+      _write_padded(column.data.data(), column.data.size());
+    }
+    _reset_group();
+  }
+
+  std::string _path;
+  std::unique_ptr<std::FILE, int (*)(std::FILE *)> _file;
+  std::vector<column_buffer> _columns;
+  size_t _group_rows;
+  size_t _group_size{};
+  size_t _group_bytes{};
+  uint64_t _row_count{};
+  uint64_t _offset{};
+  std::vector<uint64_t> _group_offsets;
+};
+
+struct snapshot_access {
+  template <typename Policy>
+  static void save(basic_statement_binder<Policy> &stmt,
+                   const std::string &path, size_t group_rows) {
+    const auto sql = stmt.sql();
+    if (!stmt.used()) {
+      stmt.execute();
+    }
+    MYSQL *db = stmt._db.get();
+    std::unique_ptr<MYSQL_RES, void (*)(MYSQL_RES *)> result(
+        mysql_use_result(db), mysql_free_result);
+    if (!result) {
+      throw exceptions::no_result_sets(
+          "no result sets to extract: exactly 1 result set expected", sql);
+    }
+    const auto tmp_path = path + ".tmp";
+    try {
+      snapshot_writer writer(tmp_path, mysql_fetch_fields(result.get()),
+                             mysql_num_fields(result.get()), sql, group_rows);
+      while (auto row = mysql_fetch_row(result.get())) {
+        writer.add_row(row, mysql_fetch_lengths(result.get()));
+      }
+      if (mysql_errno(db) != 0) {
+        throw mariadb_exception(db, sql);
+      }
+      writer.finish();
+    } catch (...) {
+      std::remove(tmp_path.c_str());
+      throw;
+    }
+    result.reset();
+    if (mysql_more_results(db)) {
+      throw exceptions::more_result_sets("no all result sets extracted", sql);
+    }
+    // readers of `path` see either the old or the new snapshot
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+      throw mariadb_exception("renaming snapshot " + tmp_path + " failed: " +
+                              std::strerror(errno));
+    }
+  }
+};
+
+} // namespace detail
+
+// Streams the result of `stmt` into a snapshot file at `path`,which is
+// replaced atomically. Rows are buffered `group_rows` at a time and stored
+// column by column.
+template <typename Policy>
+void save_snapshot(basic_statement_binder<Policy> &stmt,
+                   const std::string &path, size_t group_rows = 4096) {
+  detail::snapshot_access::save(stmt, path, group_rows);
+}
+
+template <typename Policy>
+void save_snapshot(basic_statement_binder<Policy> &&stmt,
+                   const std::string &path, size_t group_rows = 4096) {
+  detail::snapshot_access::save(stmt, path, group_rows);
+}
+
+// A snapshot file mapped into memory,extracted like a statement. Values are
+// decoded from the mapping by the same type_converters as live results.
+class result_snapshot {
+public:
+  explicit result_snapshot(const std::string &path) : _path(path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      _fail("can't be opened");
+    }
+    struct stat st {};
+    if (::fstat(fd, &st) != 0) {
+      ::close(fd);
+      _fail("can't be opened");
+    }
+    _size = static_cast<size_t>(st.st_size);
+    if (_size < detail::snapshot_header_size) {
+      ::close(fd);
+      _fail("is truncated");
+    }
+    void *data = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+      _fail("can't be mapped");
+    }
+    _data = static_cast<const char *>(data);
+    try {
+      _parse();
+    } catch (...) {
+      ::munmap(const_cast<char *>(_data), _size);
+      throw;
+    }
+  }
+
+  result_snapshot(const result_snapshot &) = delete;
+  result_snapshot &operator=(const result_snapshot &) = delete;
+
+  ~result_snapshot() { ::munmap(const_cast<char *>(_data), _size); }
+
+  uint64_t row_count() const noexcept { return _row_count; }
+  unsigned int column_count() const noexcept {
+    return static_cast<unsigned int>(_fields.size());
+  }
+  const MYSQL_FIELD *fields() const noexcept { return _fields.data(); }
+  // the statement the snapshot was saved from
+  const std::string &sql() const noexcept { return _sql; }
+
+  template <typename Result>
+  typename std::enable_if<is_mariadb_value<Result>::value, void>::type
+  operator>>(Result &value) {
+    _extract_single_row([&value, this] { _get_col_from_row(0, value); });
+  }
+
+  template <typename... Types> void operator>>(std::tuple<Types...> &&values) {
+    _extract_single_row([&values, this] {
+      std::apply(
+          [this](auto &... elements) {
+            unsigned int idx = 0;
+            (_get_col_from_row(idx++, elements), ...);
+          },
+          values);
+    });
+  }
+
+  template <typename Function>
+  typename std::enable_if<!is_mariadb_value<Function>::value, void>::type
+  operator>>(Function &&func) {
+    using traits = utility::function_traits<Function>;
+    _for_each_row([&func, this] {
+      _call(func, std::make_index_sequence<traits::arity>());
+    });
+  }
+
+private:
+  struct column_view {
+    const uint8_t *nulls;
+    const uint64_t *offsets;
+    const char *values;
+  };
+
+  [[noreturn]] void _fail(const char *reason) const {
+    throw mariadb_exception("snapshot " + _path + " " + reason);
+  }
+
+  template <typename Integer> Integer _read(size_t offset) const {
+    if (offset > _size || _size - offset < sizeof(Integer)) {
+      _fail("is truncated");
+    }
+    Integer value;
+    std::memcpy(&value, _data + offset, sizeof(value));
+    return value;
+  }
+
+  // the offset of `size` bytes at `offset`,padded
+  size_t _skip(size_t offset, uint64_t size) const {
+    if (offset > _size || size > _size - offset) {
+      _fail("is truncated");
+    }
+    return offset + static_cast<size_t>(size) +
+           detail::snapshot_padding(static_cast<size_t>(size));
+  }
+
+  void _parse() {
+    if (std::memcmp(_data, detail::snapshot_magic, 8) != 0) {
+      _fail("is not a snapshot");
+    }
+    if (_read<uint32_t>(8) != snapshot_format_version) {
+      _fail("has an unsupported version");
+    }
+    if (_read<uint32_t>(12) != detail::snapshot_byte_order) {
+      _fail("has another byte order");
+    }
+    const auto column_count = _read<uint32_t>(16);
+    const auto sql_size = _read<uint32_t>(20);
+    _row_count = _read<uint64_t>(24);
+    const auto group_count = _read<uint64_t>(32);
+    const auto index_offset = _read<uint64_t>(40);
+
+    size_t offset = detail::snapshot_header_size;
+    const auto columns_offset = _skip(offset, sql_size);
+    _sql.assign(_data + offset, sql_size);
+    offset = columns_offset;
+
+    _fields.assign(column_count, MYSQL_FIELD{});
+    for (auto &field : _fields) {
+      field.type = static_cast<enum_field_types>(_read<uint32_t>(offset));
+      field.flags = _read<uint32_t>(offset + 4);
+      field.charsetnr = _read<uint32_t>(offset + 8);
+      field.decimals = _read<uint32_t>(offset + 12);
+      field.length = static_cast<unsigned long>(_read<uint64_t>(offset + 16));
+      field.name_length = _read<uint32_t>(offset + 24);
+      offset += 32;
+      const auto next = _skip(offset, uint64_t{field.name_length} + 1);
+      if (_data[offset + field.name_length] != '\0') {
+        _fail("is corrupted");
+      }
+      field.name = const_cast<char *>(_data + offset);
+      offset = next;
+    }
+
+    if (index_offset > _size || group_count > (_size - index_offset) / 8) {
+      _fail("is truncated");
+    }
+    _groups.reserve(static_cast<size_t>(group_count));
+    uint64_t rows = 0;
+    for (uint64_t i = 0; i < group_count; i++) {
+      const auto group = _read<uint64_t>(index_offset + i * 8);
+      // the offsets of a group are read in place
+      if (group % 8 != 0) {
+        _fail("is corrupted");
+      }
+      rows += _read<uint64_t>(group);
+      _groups.push_back(static_cast<size_t>(group));
+    }
+    if (rows != _row_count) {
+      _fail("is corrupted");
+    }
+  }
+
+  // validates the group at `offset` and returns its row count
+  uint64_t _map_group(size_t offset) {
+    const auto rows = _read<uint64_t>(offset);
+    if (rows >= _size / 8) {
+      _fail("is corrupted");
+    }
+    offset += 8;
+    _columns.clear();
+    for (size_t i = 0; i < _fields.size(); i++) {
+      column_view column{};
+      column.nulls = reinterpret_cast<const uint8_t *>(_data + offset);
+      offset = _skip(offset, (rows + 7) / 8);
+      column.offsets = reinterpret_cast<const uint64_t *>(_data + offset);
+      offset = _skip(offset, (rows + 1) * 8);
+      column.values = _data + offset;
+      uint64_t previous = 0;
+      for (uint64_t row = 0; row <= rows; row++) {
+        if (column.offsets[row] < previous) {
+          _fail("is corrupted");
+        }
+        previous = column.offsets[row];
+      }
+      offset = _skip(offset, previous);
+      _columns.push_back(column);
+    }
+    return rows;
+  }
+
+  void _for_each_row(const std::function<void(void)> &call_back) {
+    for (auto group : _groups) {
+      const auto rows = _map_group(group);
+      for (_row = 0; _row < rows; _row++) {
+        call_back();
+      }
+    }
+  }
+
+  void _extract_single_row(const std::function<void(void)> &call_back) {
+    if (_row_count == 0) {
+      error(error_kind::no_rows).raise(_sql);
+    }
+    if (_row_count > 1) {
+      error(error_kind::more_rows).raise(_sql);
+    }
+    _for_each_row(call_back);
+  }
+
+  template <typename Function, size_t... Index>
+  void _call(Function &func, std::index_sequence<Index...>) {
+    using traits = utility::function_traits<Function>;
+    std::tuple<std::remove_cv_t<std::remove_reference_t<
+        typename traits::template argument<Index>>>...>
+        values;
+    (_get_col_from_row(static_cast<unsigned int>(Index),
+                       std::get<Index>(values)),
+     ...);
+    std::apply(func, std::move(values));
+  }
+
+  template <typename Result>
+  void _get_col_from_row(unsigned int idx, Result &val) {
+    if (idx >= _columns.size()) {
+      error(error_kind::out_of_row_range, idx, column_count()).raise(_sql);
+    }
+    const auto &column = _columns[idx];
+    const bool is_null = (column.nulls[_row / 8] >> (_row % 8)) & 1;
+    const auto begin = column.offsets[_row];
+    const auto status = type_converter<Result>::from_sql(
+        is_null ? nullptr : column.values + begin,
+        static_cast<size_t>(column.offsets[_row + 1] - begin), _fields[idx],
+        val);
+    if (status != conversion_status::ok) {
+      detail::throw_conversion_error(status, idx, _fields[idx], _sql);
+    }
+  }
+
+  std::string _path;
+  const char *_data{};
+  size_t _size{};
+  std::string _sql;
+  uint64_t _row_count{};
+  std::vector<MYSQL_FIELD> _fields;
+  std::vector<size_t> _groups;
+  std::vector<column_view> _columns;
+  uint64_t _row{};
+};
+
+} // namespace mariadb
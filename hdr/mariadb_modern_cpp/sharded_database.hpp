@@ -0,0 +1,407 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "connection_pool.hpp"
+#include "digest.hpp"
+#include "parallel_scan.hpp"
+#include "pipeline.hpp"
+
+namespace mariadb {
+
+struct shard_config {
+  // places the shard on the hash ring,so it must stay the same when shards
+  // are added,removed or reordered
+  std::string name;
+  mariadb_config config;
+  size_t pool_size{4};
+};
+
+struct scatter_options {
+  // rows delivered at most,0 for all. Each shard returns at most `limit`
+  // rows by a LIMIT clause appended to the statement.
+  size_t limit{0};
+  // rows handed from a shard to the calling thread at once
+  size_t batch_rows{256};
+  // batches queued per shard before its worker waits. The rows are read
+  // unbuffered,so this bounds the rows held per shard.
+  size_t max_batches{4};
+};
+
+namespace detail {
+
+// FNV-1a with a final mix,so that nearby keys spread over the ring
+inline uint64_t shard_hash(std::string_view bytes) noexcept {
+  fnv1a_sink sink;
+  for (auto c : bytes) {
+    sink.put(c);
+  }
+  auto h = sink.hash;
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+} // namespace detail
+
+// Shards of the same schema,each behind a connection_pool. Keys map to
+// shards by consistent hashing,so adding or removing a shard only moves the
+// keys of its neighbours on the ring. Statements run on all shards
+// concurrently by scatter() and scatter_merge().
+class sharded_database {
+public:
+  static constexpr size_t default_virtual_nodes = 160;
+
+  explicit sharded_database(std::vector<shard_config> shards,
+                            size_t virtual_nodes = default_virtual_nodes) {
+    if (shards.empty()) {
+      throw mariadb_exception("sharded_database needs at least one shard");
+    }
+    virtual_nodes = std::max<size_t>(virtual_nodes, 1);
+    for (size_t i = 0; i < shards.size(); i++) {
+      auto &shard = shards[i];
+      _names.push_back(shard.name.empty() ? std::to_string(i) : shard.name);
+      _pools.push_back(std::make_unique<connection_pool>(
+          std::move(shard.config), shard.pool_size));
+      for (size_t node = 0; node < virtual_nodes; node++) {
+        _ring.emplace_back(
+            detail::shard_hash(_names.back() + '#' + std::to_string(node)),
+            i);
+      }
+    }
+    std::sort(_ring.begin(), _ring.end());
+  }
+
+  sharded_database(const sharded_database &) = delete;
+  sharded_database &operator=(const sharded_database &) = delete;
+
+  size_t shard_count() const noexcept { return _pools.size(); }
+  const std::string &shard_name(size_t shard) const { return _names[shard]; }
+  connection_pool &pool(size_t shard) { return *_pools[shard]; }
+
+  // Integers are hashed by their decimal text,so 42 and "42" are on the
+  // same shard.
+  template <typename Key> size_t shard_of(const Key &key) const {
+    uint64_t h{};
+    if constexpr (std::is_integral_v<Key>) {
+      h = detail::shard_hash(std::to_string(key));
+    } else {
+      h = detail::shard_hash(std::string_view(key));
+    }
+    auto it = std::lower_bound(_ring.begin(), _ring.end(),
+                               std::pair<uint64_t, size_t>(h, 0));
+    if (it == _ring.end()) {
+      it = _ring.begin();
+    }
+    return it->second;
+  }
+
+  // a connection to the shard of `key`,blocks until one is available
+  template <typename Key> connection_pool::lease connection(const Key &key) {
+    return _pools[shard_of(key)]->acquire();
+  }
+
+  // Runs `sql` on every shard concurrently and invokes `callback` from the
+  // calling thread for the rows of all shards,in no particular order.
+  template <typename Function, typename... Arguments>
+  void scatter(const std::string &sql, Function &&callback,
+               const scatter_options &options = {},
+               const Arguments &... arguments) {
+    _gather(sql, callback, options, static_cast<std::nullptr_t *>(nullptr),
+            arguments...);
+  }
+
+  // Like scatter(),but the rows are delivered in the order of `less`,which
+  // compares tuples of the callback argument types. `sql` must sort the
+  // rows of each shard in the same order,e.g. by an ORDER BY clause,and
+  // the sorted runs are merged.
+  template <typename Function, typename Less, typename... Arguments>
+  void scatter_merge(const std::string &sql, Function &&callback, Less less,
+                     const scatter_options &options = {},
+                     const Arguments &... arguments) {
+    _gather(sql, callback, options, &less, arguments...);
+  }
+
+private:
+  template <typename Row> struct channel {
+    std::deque<std::vector<Row>> batches;
+    bool done{false};
+  };
+
+  // thrown into a worker's extraction once the rows aren't needed
+  struct stopped {};
+
+  template <typename Function, typename Less, typename... Arguments>
+  void _gather(const std::string &sql, Function &callback,
+               const scatter_options &options, Less *less,
+               const Arguments &... arguments) {
+    using traits = utility::function_traits<std::remove_reference_t<Function>>;
+    using row_type = typename detail::scan_row_tuple<
+        std::remove_reference_t<Function>,
+        std::make_index_sequence<traits::arity>>::type;
+
+    std::string shard_sql = sql;
+    if (options.limit != 0) {
+      while (!shard_sql.empty() &&
+             (shard_sql.back() == ';' ||
+              std::isspace(static_cast<unsigned char>(shard_sql.back())))) {
+        shard_sql.pop_back();
+      }
+      shard_sql += " LIMIT " + std::to_string(options.limit);
+    }
+    const size_t batch_rows = std::max<size_t>(options.batch_rows, 1);
+    const size_t max_batches = std::max<size_t>(options.max_batches, 1);
+    const size_t shard_count = _pools.size();
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::vector<channel<row_type>> channels(shard_count);
+    bool stop{false};
+    std::exception_ptr failure;
+
+    auto fail = [&](std::exception_ptr e) {
+      std::lock_guard lk(mtx);
+      if (!failure) {
+        failure = e;
+      }
+      stop = true;
+      cv.notify_all();
+    };
+
+    // returns false once the rows aren't needed
+    auto push = [&](size_t shard, std::vector<row_type> &batch) {
+      std::unique_lock lk(mtx);
+      cv.wait(lk, [&] {
+        return stop || channels[shard].batches.size() < max_batches;
+      });
+      if (stop) {
+        return false;
+      }
+      channels[shard].batches.push_back(std::move(batch));
+      cv.notify_all();
+      return true;
+    };
+
+    auto worker = [&](size_t shard) {
+      init_thread();
+      try {
+        auto db = _pools[shard]->acquire();
+        std::vector<row_type> batch;
+        batch.reserve(batch_rows);
+        _stream<row_type>(*db, shard_sql, batch, [&] {
+          if (batch.size() == batch_rows) {
+            if (!push(shard, batch)) {
+              throw stopped{};
+            }
+            batch.clear();
+            batch.reserve(batch_rows);
+          }
+        }, arguments...);
+        if (!batch.empty()) {
+          push(shard, batch);
+        }
+      } catch (const stopped &) {
+      } catch (...) {
+        fail(std::current_exception());
+      }
+      std::lock_guard lk(mtx);
+      channels[shard].done = true;
+      cv.notify_all();
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(shard_count);
+    try {
+      for (size_t i = 0; i < shard_count; i++) {
+        threads.emplace_back(worker, i);
+      }
+
+      size_t delivered = 0;
+      auto deliver = [&](row_type &&row) {
+        std::apply(callback, std::move(row));
+        return options.limit == 0 || ++delivered < options.limit;
+      };
+      // waits for the next batch of `shard`,returns false once it's drained
+      auto next_batch = [&](size_t shard, std::vector<row_type> &batch) {
+        std::unique_lock lk(mtx);
+        cv.wait(lk, [&] {
+          return failure || !channels[shard].batches.empty() ||
+                 channels[shard].done;
+        });
+        if (failure || channels[shard].batches.empty()) {
+          return false;
+        }
+        batch = std::move(channels[shard].batches.front());
+        channels[shard].batches.pop_front();
+        cv.notify_all();
+        return true;
+      };
+
+      if constexpr (std::is_same_v<Less, std::nullptr_t>) {
+        (void)next_batch;
+        // the shards are polled round robin,so none of them falls behind
+        size_t first = 0;
+        while (true) {
+          std::vector<row_type> batch;
+          {
+            std::unique_lock lk(mtx);
+            std::optional<size_t> ready;
+            cv.wait(lk, [&] {
+              if (failure) {
+                return true;
+              }
+              bool all_done = true;
+              for (size_t n = 0; n < shard_count; n++) {
+                const auto shard = (first + n) % shard_count;
+                if (!channels[shard].batches.empty()) {
+                  ready = shard;
+                  return true;
+                }
+                all_done = all_done && channels[shard].done;
+              }
+              return all_done;
+            });
+            if (failure || !ready) {
+              break;
+            }
+            batch = std::move(channels[*ready].batches.front());
+            channels[*ready].batches.pop_front();
+            first = *ready + 1;
+            cv.notify_all();
+          }
+          bool more = true;
+          for (auto &row : batch) {
+            if (!(more = deliver(std::move(row)))) {
+              break;
+            }
+          }
+          if (!more) {
+            break;
+          }
+        }
+      } else {
+        // a k-way merge over a heap of shards ordered by their current row
+        std::vector<std::vector<row_type>> batches(shard_count);
+        std::vector<size_t> positions(shard_count);
+        auto greater = [&](size_t a, size_t b) {
+          const auto &row_a = batches[a][positions[a]];
+          const auto &row_b = batches[b][positions[b]];
+          if ((*less)(row_b, row_a)) {
+            return true;
+          }
+          // ties go to the lower shard first
+          return !(*less)(row_a, row_b) && a > b;
+        };
+        std::vector<size_t> heap;
+        for (size_t shard = 0; shard < shard_count; shard++) {
+          if (next_batch(shard, batches[shard]) && !batches[shard].empty()) {
+            heap.push_back(shard);
+          }
+        }
+        std::make_heap(heap.begin(), heap.end(), greater);
+        while (!heap.empty()) {
+          std::pop_heap(heap.begin(), heap.end(), greater);
+          const auto shard = heap.back();
+          heap.pop_back();
+          if (!deliver(std::move(batches[shard][positions[shard]]))) {
+            break;
+          }
+          if (++positions[shard] == batches[shard].size()) {
+            positions[shard] = 0;
+            if (!next_batch(shard, batches[shard]) ||
+                batches[shard].empty()) {
+              continue;
+            }
+          }
+          heap.push_back(shard);
+          std::push_heap(heap.begin(), heap.end(), greater);
+        }
+      }
+    } catch (...) {
+      fail(std::current_exception());
+    }
+
+    {
+      std::lock_guard lk(mtx);
+      stop = true;
+      cv.notify_all();
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    if (failure) {
+      std::rethrow_exception(failure);
+    }
+  }
+
+  // Reads the rows of `sql` unbuffered by mysql_use_result into `rows`,
+  // calling `on_row` after each. Rows left when it throws are skipped by
+  // the connector when the result is freed.
+  template <typename Row, typename OnRow, typename... Arguments>
+  static void _stream(database &db, const std::string &sql,
+                      std::vector<Row> &rows, OnRow on_row,
+                      const Arguments &... arguments) {
+    auto stmt = db.statement(sql);
+    stmt.bind(arguments...);
+    stmt.execute();
+    MYSQL *mysql = db.handle().get();
+    std::unique_ptr<MYSQL_RES, void (*)(MYSQL_RES *)> result(
+        mysql_use_result(mysql), mysql_free_result);
+    if (!result) {
+      if (mysql_errno(mysql) != 0) {
+        throw mariadb_exception(mysql, sql);
+      }
+      throw exceptions::no_result_sets(
+          "no result sets to extract: exactly 1 result set expected", sql);
+    }
+    const auto field_count = mysql_num_fields(result.get());
+    const MYSQL_FIELD *fields = mysql_fetch_fields(result.get());
+    if (std::tuple_size_v<Row> > field_count) {
+      throw exceptions::out_of_row_range(
+          std::string("try to access column ") +
+              std::to_string(std::tuple_size_v<Row> - 1) +
+              " ,exceeds column count " + std::to_string(field_count),
+          sql);
+    }
+    detail::scan_row_collector<Row> collect{&rows};
+    while (MYSQL_ROW row = mysql_fetch_row(result.get())) {
+      detail::pipeline_access::_consume_row(
+          collect, row, mysql_fetch_lengths(result.get()), fields, sql,
+          std::make_index_sequence<std::tuple_size_v<Row>>());
+      on_row();
+    }
+    if (mysql_errno(mysql) != 0) {
+      throw mariadb_exception(mysql, sql);
+    }
+    result.reset();
+    if (mysql_more_results(mysql)) {
+      throw exceptions::more_result_sets("no all result sets extracted", sql);
+    }
+  }
+
+  std::vector<std::string> _names;
+  std::vector<std::unique_ptr<connection_pool>> _pools;
+  // sorted (hash,shard) pairs,each shard has virtual_nodes of them
+  std::vector<std::pair<uint64_t, size_t>> _ring;
+};
+
+} // namespace mariadb
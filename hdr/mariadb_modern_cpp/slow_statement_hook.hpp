@@ -0,0 +1,95 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+
+#include "errors.hpp"
+
+namespace mariadb {
+
+// Receives the statements of statement_binder which took longer than the
+// threshold it was installed with,see explain_capture.
+class slow_statement_sink {
+public:
+  virtual ~slow_statement_sink() = default;
+
+  // Called on the thread of the statement,so it must return quickly.
+  // `sql` has the arguments bound,`affected_rows` is 0 for statements
+  // returning rows.
+  virtual void slow_statement(uint64_t digest, std::string_view sql,
+                              std::chrono::nanoseconds latency,
+                              uint64_t affected_rows,
+                              bool failed) noexcept = 0;
+};
+
+namespace detail {
+
+// The installed sink. Statements only read the threshold,the lock is taken
+// for the slow ones,so that uninstall() never races with a report.
+class slow_statement_hook {
+public:
+  // 0 while no sink is installed
+  static int64_t threshold_ns() noexcept {
+    return _threshold().load(std::memory_order_relaxed);
+  }
+
+  static void install(slow_statement_sink *sink,
+                      std::chrono::nanoseconds threshold) {
+    std::lock_guard lk(_mtx());
+    if (_sink() && _sink() != sink) {
+      throw mariadb_exception("a slow statement sink is already installed");
+    }
+    _sink() = sink;
+    _threshold().store(std::max<int64_t>(threshold.count(), 1),
+                       std::memory_order_relaxed);
+  }
+
+  static void uninstall(slow_statement_sink *sink) noexcept {
+    std::lock_guard lk(_mtx());
+    if (_sink() == sink) {
+      _sink() = nullptr;
+      _threshold().store(0, std::memory_order_relaxed);
+    }
+  }
+
+  // the statements of the calling thread are not reported,e.g. of the
+  // thread of the sink
+  static void mute_thread() noexcept { _muted() = true; }
+
+  static void report(uint64_t digest, std::string_view sql,
+                     std::chrono::nanoseconds latency, uint64_t affected_rows,
+                     bool failed) noexcept {
+    if (_muted()) {
+      return;
+    }
+    std::lock_guard lk(_mtx());
+    if (_sink()) {
+      _sink()->slow_statement(digest, sql, latency, affected_rows, failed);
+    }
+  }
+
+private:
+  static std::atomic<int64_t> &_threshold() noexcept {
+    static std::atomic<int64_t> threshold{0};
+    return threshold;
+  }
+  static slow_statement_sink *&_sink() noexcept {
+    static slow_statement_sink *sink{};
+    return sink;
+  }
+  static bool &_muted() noexcept {
+    thread_local bool muted{false};
+    return muted;
+  }
+  static std::mutex &_mtx() noexcept {
+    static std::mutex mtx;
+    return mtx;
+  }
+};
+
+} // namespace detail
+} // namespace mariadb
@@ -0,0 +1,286 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "digest.hpp"
+
+namespace mariadb {
+
+struct digest_stats {
+  uint64_t digest{};
+  // the first statement text seen with this digest,normalized
+  std::string sql;
+  uint64_t executions{};
+  uint64_t errors{};
+  // the errors from deadlines
+  uint64_t timeouts{};
+  uint64_t rows{};
+  std::chrono::nanoseconds total_latency{};
+  std::chrono::nanoseconds max_latency{};
+};
+
+// Aggregates the executions of statement_binder and prepared_statement by
+// digest once enabled. Each thread records into its own fixed size table,
+// so recording takes no lock and no atomic read-modify-write,and snapshot()
+// merges the tables of all threads. When a thread exits,its table is merged
+// into the statistics of the exited threads and freed.
+class statement_stats {
+public:
+  // distinct digests recorded per thread,the others are merged under
+  // digest 0
+  static constexpr size_t slots_per_thread = 512;
+
+  static void enable(bool on = true) noexcept {
+    _enabled().store(on, std::memory_order_relaxed);
+  }
+  static bool enabled() noexcept {
+    return _enabled().load(std::memory_order_relaxed);
+  }
+
+  // `executed` is false when only rows of an already counted execution are
+  // added
+  static void record(uint64_t digest, std::string_view sql,
+                     std::chrono::nanoseconds latency, uint64_t rows,
+                     bool failed, bool executed = true,
+                     bool timed_out = false) noexcept {
+    auto *table = _local_table();
+    if (!table) {
+      return;
+    }
+    auto &slot = table->find(digest, sql);
+    const auto ns = static_cast<uint64_t>(latency.count());
+    _add(slot.executions, executed ? 1 : 0);
+    _add(slot.errors, failed ? 1 : 0);
+    _add(slot.timeouts, timed_out ? 1 : 0);
+    _add(slot.rows, rows);
+    _add(slot.total_ns, ns);
+    if (ns > slot.max_ns.load(std::memory_order_relaxed)) {
+      slot.max_ns.store(ns, std::memory_order_relaxed);
+    }
+  }
+
+  // the statistics of all threads,sorted by total latency
+  static std::vector<digest_stats> snapshot() {
+    std::unordered_map<uint64_t, digest_stats> merged;
+    {
+      auto &reg = _registry();
+      std::lock_guard lk(reg.mtx);
+      merged = reg.retired;
+      for (const auto *table : reg.tables) {
+        _merge(merged, *table, 0);
+      }
+    }
+    std::vector<digest_stats> res;
+    res.reserve(merged.size());
+    for (auto &[digest, stats] : merged) {
+      res.push_back(std::move(stats));
+    }
+    std::sort(res.begin(), res.end(), [](const auto &a, const auto &b) {
+      return a.total_latency > b.total_latency;
+    });
+    return res;
+  }
+
+  // one JSON object per digest
+  static std::string to_json(const std::vector<digest_stats> &stats) {
+    std::string out = "[";
+    for (const auto &s : stats) {
+      if (out.size() > 1) {
+        out.push_back(',');
+      }
+      char buffer[320];
+      std::snprintf(buffer, sizeof(buffer),
+                    "{\"digest\":\"%016llx\",\"executions\":%llu,"
+                    "\"errors\":%llu,\"timeouts\":%llu,\"rows\":%llu,"
+                    "\"total_latency_ns\":%lld,\"max_latency_ns\":%lld,"
+                    "\"sql\":\"",
+                    static_cast<unsigned long long>(s.digest),
+                    static_cast<unsigned long long>(s.executions),
+                    static_cast<unsigned long long>(s.errors),
+                    static_cast<unsigned long long>(s.timeouts),
+                    static_cast<unsigned long long>(s.rows),
+                    static_cast<long long>(s.total_latency.count()),
+                    static_cast<long long>(s.max_latency.count()));
+      out.append(buffer);
+      for (char c : s.sql) {
+        if (c == '"' || c == '\\') {
+          out.push_back('\\');
+          out.push_back(c);
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+          std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+          out.append(buffer);
+        } else {
+          out.push_back(c);
+        }
+      }
+      out.append("\"}");
+    }
+    out.push_back(']');
+    return out;
+  }
+
+private:
+  struct slot_type {
+    // published after sql is written
+    std::atomic<uint64_t> digest{0};
+    std::string sql;
+    std::atomic<uint64_t> executions{0};
+    std::atomic<uint64_t> errors{0};
+    std::atomic<uint64_t> timeouts{0};
+    std::atomic<uint64_t> rows{0};
+    std::atomic<uint64_t> total_ns{0};
+    std::atomic<uint64_t> max_ns{0};
+  };
+
+  struct table_type {
+    static constexpr uint64_t empty = ~uint64_t{0};
+
+    table_type() {
+      for (auto &slot : slots) {
+        slot.digest.store(empty, std::memory_order_relaxed);
+      }
+      overflow.digest.store(empty, std::memory_order_relaxed);
+      overflow.sql = "(other statements)";
+    }
+
+    // only called by the owning thread
+    slot_type &find(uint64_t digest, std::string_view sql) noexcept {
+      if (digest == empty) {
+        digest--;
+      }
+      for (size_t i = 0; i < slots_per_thread; i++) {
+        auto &slot = slots[(digest + i) % slots_per_thread];
+        const auto current = slot.digest.load(std::memory_order_relaxed);
+        if (current == digest) {
+          return slot;
+        }
+        if (current == empty) {
+          try {
+            slot.sql = normalize_sql(sql);
+          } catch (...) {
+          }
+          slot.digest.store(digest, std::memory_order_release);
+          return slot;
+        }
+      }
+      overflow.digest.store(0, std::memory_order_release);
+      return overflow;
+    }
+
+    slot_type slots[slots_per_thread];
+    slot_type overflow;
+  };
+
+  struct registry {
+    std::mutex mtx;
+    // the tables of the running threads
+    std::vector<const table_type *> tables;
+    // the statistics of the exited threads
+    std::unordered_map<uint64_t, digest_stats> retired;
+  };
+
+  // the table of a thread,retired when the thread exits
+  struct local_table {
+    local_table() noexcept {
+      try {
+        auto &reg = _registry();
+        auto owned = std::make_unique<table_type>();
+        std::lock_guard lk(reg.mtx);
+        reg.tables.push_back(owned.get());
+        table = std::move(owned);
+      } catch (...) {
+        // the statements of this thread aren't recorded
+      }
+    }
+
+    local_table(const local_table &) = delete;
+    local_table &operator=(const local_table &) = delete;
+
+    ~local_table() {
+      if (!table) {
+        return;
+      }
+      auto &reg = _registry();
+      std::lock_guard lk(reg.mtx);
+      try {
+        _merge(reg.retired, *table, max_retired_digests);
+      } catch (...) {
+        // the counts of this thread are lost
+      }
+      reg.tables.erase(
+          std::find(reg.tables.begin(), reg.tables.end(), table.get()));
+    }
+
+    std::unique_ptr<table_type> table;
+  };
+
+  // distinct digests kept for the exited threads,the others are merged
+  // under digest 0
+  static constexpr size_t max_retired_digests = 8 * slots_per_thread;
+
+  // adds the counts of `table` to `merged`,under digest 0 once `merged` has
+  // `max_digests` unless it's 0
+  static void _merge(std::unordered_map<uint64_t, digest_stats> &merged,
+                     const table_type &table, size_t max_digests) {
+    for (size_t i = 0; i <= slots_per_thread; i++) {
+      const auto &slot =
+          i < slots_per_thread ? table.slots[i] : table.overflow;
+      auto digest = slot.digest.load(std::memory_order_acquire);
+      if (digest == table_type::empty) {
+        continue;
+      }
+      if (max_digests > 0 && merged.size() >= max_digests &&
+          merged.find(digest) == merged.end()) {
+        digest = 0;
+      }
+      auto &stats = merged[digest];
+      if (stats.sql.empty()) {
+        stats.digest = digest;
+        stats.sql = digest == 0 ? table.overflow.sql : slot.sql;
+      }
+      stats.executions += slot.executions.load(std::memory_order_relaxed);
+      stats.errors += slot.errors.load(std::memory_order_relaxed);
+      stats.timeouts += slot.timeouts.load(std::memory_order_relaxed);
+      stats.rows += slot.rows.load(std::memory_order_relaxed);
+      stats.total_latency += std::chrono::nanoseconds(
+          slot.total_ns.load(std::memory_order_relaxed));
+      stats.max_latency =
+          std::max(stats.max_latency,
+                   std::chrono::nanoseconds(
+                       slot.max_ns.load(std::memory_order_relaxed)));
+    }
+  }
+
+  static void _add(std::atomic<uint64_t> &counter, uint64_t value) noexcept {
+    counter.store(counter.load(std::memory_order_relaxed) + value,
+                  std::memory_order_relaxed);
+  }
+
+  static std::atomic<bool> &_enabled() noexcept {
+    static std::atomic<bool> enabled{false};
+    return enabled;
+  }
+
+  static registry &_registry() {
+    static registry reg;
+    return reg;
+  }
+
+  // nullptr if the table couldn't be allocated
+  static table_type *_local_table() noexcept {
+    thread_local local_table local;
+    return local.table.get();
+  }
+};
+
+} // namespace mariadb
@@ -0,0 +1,526 @@
+#pragma once
+
+#include <cerrno>
+#include <charconv>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "errors.hpp"
+#include "result.hpp"
+#include "type_traits.hpp"
+#include "types.hpp"
+#include "utility/escape_scan.hpp"
+
+namespace mariadb {
+
+// Receives the sql literal of an argument of statement_binder,or a field of
+// the rows bulk_loader feeds to LOAD DATA INFILE.
+class sql_writer {
+public:
+  enum class target {
+    // sql literals
+    statement,
+    // text fields escaped by '\\',as bulk_loader sends them
+    infile,
+  };
+
+  sql_writer(MYSQL *db, std::string &sql,
+             target to = target::statement) noexcept
+      : _db(db), _sql(sql), _target(to) {}
+
+  void write_null() {
+    _sql.append(_target == target::infile ? "\\N" : "NULL");
+  }
+
+  template <typename Integer> void write_integer(Integer val) {
+    char buffer[std::numeric_limits<Integer>::digits10 + 3];
+    const auto res = std::to_chars(buffer, buffer + sizeof(buffer), val);
+    _sql.append(buffer, res.ptr);
+  }
+
+  template <typename Float> void write_floating(Float val) {
+    char buffer[64];
+    const auto n = std::snprintf(buffer, sizeof(buffer), "%.*Lg",
+                                 std::numeric_limits<Float>::max_digits10,
+                                 static_cast<long double>(val));
+    _sql.append(buffer, static_cast<size_t>(n));
+  }
+
+  // writes a quoted and escaped string
+  void write_string(const void *str, size_t size) {
+    const auto *data = static_cast<const char *>(str);
+    if (_target == target::infile) {
+      _write_infile_field(data, size);
+      return;
+    }
+    // the bytes before the first one to escape are copied as is,the rest is
+    // left to the connector,which knows about NO_BACKSLASH_ESCAPES
+    const size_t clean = _ascii_compatible() ? utility::find_escape(data, size)
+                                             : 0;
+    const auto old_size = _sql.size();
+    if (clean == size) {
+      _sql.push_back('\'');
+      _sql.append(data, size);
+      _sql.push_back('\'');
+      return;
+    }
+    _sql.resize(old_size + 1 + clean + (size - clean) * 2 + 1);
+    _sql[old_size] = '\'';
+    std::memcpy(_sql.data() + old_size + 1, data, clean);
+    auto const real_size = mysql_real_escape_string(
+        _db, _sql.data() + old_size + 1 + clean, data + clean, size - clean);
+    if (real_size == static_cast<unsigned long>(-1)) {
+      _sql.resize(old_size);
+      throw mariadb_exception(_db);
+    }
+    _sql.resize(old_size + 1 + clean + real_size);
+    _sql.push_back('\'');
+  }
+
+  // writes a string without bytes to escape,quoted unless in a field
+  void write_plain_string(const char *str, size_t size) {
+    if (_target == target::infile) {
+      _sql.append(str, size);
+      return;
+    }
+    _sql.push_back('\'');
+    _sql.append(str, size);
+    _sql.push_back('\'');
+  }
+
+  // writes the value of a BIT column,`size` bytes in big-endian order
+  void write_bits(const char *bytes, size_t size) {
+    if (_target == target::infile) {
+      _write_infile_field(bytes, size);
+      return;
+    }
+    _sql.append("b'");
+    for (size_t i = 0; i < size; i++) {
+      for (unsigned bit = 8; bit > 0; bit--) {
+        _sql.push_back(static_cast<unsigned char>(bytes[i]) &
+                               (1u << (bit - 1))
+                           ? '1'
+                           : '0');
+      }
+    }
+    _sql.push_back('\'');
+  }
+
+  // writes sql text as is,in a field it must not contain tabs,newlines or
+  // backslashes
+  void write_raw(const char *str, size_t size) { _sql.append(str, size); }
+  void write_raw(std::string_view str) { _sql.append(str.data(), str.size()); }
+
+  // false for the character sets whose multibyte characters can contain
+  // '\\' and other ASCII bytes,their strings are only escaped by the
+  // connector
+  static bool ascii_compatible(const char *charset) noexcept {
+    if (!charset) {
+      return false;
+    }
+    for (const char *unsafe : {"big5", "cp932", "gb18030", "gbk", "sjis"}) {
+      if (std::strcmp(charset, unsafe) == 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+private:
+  bool _ascii_compatible() const noexcept {
+    return ascii_compatible(mysql_character_set_name(_db));
+  }
+
+  // escapes the bytes LOAD DATA reads as separators or escapes. The server
+  // reads multibyte characters whole,so this needs an ASCII compatible
+  // character set.
+  void _write_infile_field(const char *data, size_t size) {
+    if (!_ascii_compatible()) {
+      throw mariadb_exception(
+          "fields can't be escaped in the character set of the connection");
+    }
+    _sql.reserve(_sql.size() + size);
+    for (size_t i = 0; i < size; i++) {
+      const char c = data[i];
+      switch (c) {
+      case '\0':
+        _sql.append("\\0");
+        break;
+      case '\t':
+        _sql.append("\\t");
+        break;
+      case '\n':
+        _sql.append("\\n");
+        break;
+      case '\r':
+        _sql.append("\\r");
+        break;
+      case '\\':
+        _sql.append("\\\\");
+        break;
+      default:
+        _sql.push_back(c);
+      }
+    }
+  }
+
+  MYSQL *_db;
+  std::string &_sql;
+  target _target;
+};
+
+enum class conversion_status {
+  ok,
+  null_value,
+  unsupported_column_type,
+  failed,
+  bad_alignment,
+};
+
+/*
+  Specialize type_converter to bind and extract other types:
+
+  template <> struct mariadb::type_converter<user_id> {
+    static void to_sql(sql_writer &out, const user_id &val) {
+      out.write_integer(val.value);
+    }
+    // data is nullptr for NULL
+    static conversion_status from_sql(const char *data, size_t size,
+                                      const MYSQL_FIELD &field, user_id &val);
+  };
+
+  The specialization must be visible before the type is used.
+*/
+
+namespace detail {
+inline bool is_binary_column(const MYSQL_FIELD &field) noexcept {
+  /*
+   To distinguish between binary and nonbinary data for string data types,
+   check whether the charsetnr value is 63. If so, the character set is
+   binary, which indicates binary rather than nonbinary data. This enables
+   you to distinguish BINARY from CHAR, VARBINARY from VARCHAR, and the BLOB
+   types from the TEXT types.
+
+   see https://dev.mysql.com/doc/refman/8.0/en/c-api-data-structures.html
+   */
+  switch (field.type) {
+  case MYSQL_TYPE_TINY_BLOB:
+  case MYSQL_TYPE_MEDIUM_BLOB:
+  case MYSQL_TYPE_LONG_BLOB:
+  case MYSQL_TYPE_BLOB:
+    return field.charsetnr == 63;
+  case MYSQL_TYPE_GEOMETRY:
+    return true;
+  default:
+    return false;
+  }
+}
+
+inline error_kind conversion_error_kind(conversion_status status) noexcept {
+  switch (status) {
+  case conversion_status::null_value:
+    return error_kind::can_not_hold_null;
+  case conversion_status::failed:
+    return error_kind::column_conversion;
+  case conversion_status::bad_alignment:
+    return error_kind::bad_alignment;
+  default:
+    return error_kind::unsupported_column_type;
+  }
+}
+
+// throws the exception matching a failed conversion of column `idx`
+[[noreturn]] inline void throw_conversion_error(conversion_status status,
+                                                unsigned int idx,
+                                                const MYSQL_FIELD &field,
+                                                const std::string &sql) {
+  error(conversion_error_kind(status), idx, field.type).raise(sql);
+}
+} // namespace detail
+
+template <typename Integer>
+struct type_converter<Integer,
+                      typename std::enable_if<std::is_integral<Integer>::value>::type> {
+  static void to_sql(sql_writer &out, Integer val) {
+    if constexpr (std::is_same_v<Integer, bool>) {
+      out.write_raw(val ? "1" : "0", 1);
+    } else {
+      out.write_integer(val);
+    }
+  }
+
+  static conversion_status from_sql(const char *data, size_t size,
+                                    const MYSQL_FIELD &field,
+                                    Integer &val) noexcept {
+    if (!data) {
+      return conversion_status::null_value;
+    }
+    switch (field.type) {
+    case MYSQL_TYPE_YEAR:
+    case MYSQL_TYPE_TINY:
+    case MYSQL_TYPE_SHORT:
+    case MYSQL_TYPE_LONG:
+    case MYSQL_TYPE_LONGLONG:
+    case MYSQL_TYPE_INT24:
+      break;
+    default:
+      return conversion_status::unsupported_column_type;
+    }
+
+    std::from_chars_result res{};
+    if (field.flags & UNSIGNED_FLAG) {
+      unsigned long long real_value{};
+      res = std::from_chars(data, data + size, real_value);
+      val = static_cast<Integer>(real_value);
+    } else {
+      long long real_value{};
+      res = std::from_chars(data, data + size, real_value);
+      val = static_cast<Integer>(real_value);
+    }
+    if (res.ec != std::errc() || res.ptr != data + size) {
+      return conversion_status::failed;
+    }
+    return conversion_status::ok;
+  }
+};
+
+template <typename Float>
+struct type_converter<
+    Float, typename std::enable_if<std::is_floating_point<Float>::value>::type> {
+  static void to_sql(sql_writer &out, Float val) { out.write_floating(val); }
+
+  static conversion_status from_sql(const char *data, size_t size,
+                                    const MYSQL_FIELD &field,
+                                    Float &val) noexcept {
+    if (!data) {
+      return conversion_status::null_value;
+    }
+    switch (field.type) {
+    case MYSQL_TYPE_DECIMAL:
+    case MYSQL_TYPE_NEWDECIMAL:
+    case MYSQL_TYPE_FLOAT:
+    case MYSQL_TYPE_DOUBLE:
+      break;
+    default:
+      return conversion_status::unsupported_column_type;
+    }
+
+    // strtold needs a terminated string,and the text of a number is short
+    char buffer[128];
+    if (size >= sizeof(buffer)) {
+      return conversion_status::failed;
+    }
+    std::memcpy(buffer, data, size);
+    buffer[size] = '\0';
+    char *end = nullptr;
+    errno = 0;
+    val = static_cast<Float>(::strtold(buffer, &end));
+    if (errno != 0 || end != buffer + size) {
+      return conversion_status::failed;
+    }
+    return conversion_status::ok;
+  }
+};
+
+template <typename Traits, typename Allocator>
+struct type_converter<std::basic_string<char, Traits, Allocator>> {
+  using value_type = std::basic_string<char, Traits, Allocator>;
+
+  static void to_sql(sql_writer &out, const value_type &val) {
+    out.write_string(val.data(), val.size());
+  }
+
+  // any column except binary ones is returned as text by the server
+  static conversion_status from_sql(const char *data, size_t size,
+                                    const MYSQL_FIELD &field,
+                                    value_type &val) {
+    if (!data) {
+      return conversion_status::null_value;
+    }
+    if (detail::is_binary_column(field)) {
+      return conversion_status::unsupported_column_type;
+    }
+    val.assign(data, size);
+    return conversion_status::ok;
+  }
+};
+
+// a vector of primitives is treated as a continuous memory block
+template <typename Type, typename Allocator>
+struct type_converter<
+    std::vector<Type, Allocator>,
+    typename std::enable_if<std::is_floating_point<Type>::value ||
+                            std::is_integral<Type>::value ||
+                            std::is_same<std::byte, Type>::value>::type> {
+  using value_type = std::vector<Type, Allocator>;
+
+  static void to_sql(sql_writer &out, const value_type &val) {
+    out.write_string(val.data(), val.size() * sizeof(Type));
+  }
+
+  static conversion_status from_sql(const char *data, size_t size,
+                                    const MYSQL_FIELD &field,
+                                    value_type &val) {
+    if (!data) {
+      return conversion_status::null_value;
+    }
+    switch (field.type) {
+    case MYSQL_TYPE_TINY_BLOB:
+    case MYSQL_TYPE_MEDIUM_BLOB:
+    case MYSQL_TYPE_LONG_BLOB:
+    case MYSQL_TYPE_BLOB:
+      break;
+    default:
+      return conversion_status::unsupported_column_type;
+    }
+    if (size % sizeof(Type) != 0) {
+      return conversion_status::bad_alignment;
+    }
+    val.resize(size / sizeof(Type));
+    std::memcpy(val.data(), data, size);
+    return conversion_status::ok;
+  }
+};
+
+template <>
+struct type_converter<decimal> {
+  static void to_sql(sql_writer &out, const decimal &val) {
+    char buffer[decimal::max_chars];
+    out.write_raw(buffer, static_cast<size_t>(val.to_chars(buffer) - buffer));
+  }
+
+  static conversion_status from_sql(const char *data, size_t size,
+                                    const MYSQL_FIELD &field,
+                                    decimal &val) noexcept {
+    if (!data) {
+      return conversion_status::null_value;
+    }
+    if (field.type != MYSQL_TYPE_DECIMAL &&
+        field.type != MYSQL_TYPE_NEWDECIMAL) {
+      return conversion_status::unsupported_column_type;
+    }
+    return decimal::from_chars(data, data + size, val)
+               ? conversion_status::ok
+               : conversion_status::failed;
+  }
+};
+
+// time points are interpreted as UTC,so set the session time_zone to
+// '+00:00' to read TIMESTAMP columns as such
+template <typename Temporal>
+struct type_converter<
+    Temporal, typename std::enable_if<detail::is_temporal<Temporal>::value>::type> {
+  static void to_sql(sql_writer &out, const Temporal &val) {
+    char buffer[32];
+    out.write_plain_string(
+        buffer, detail::format_mysql_time(detail::to_mysql_time(val), buffer));
+  }
+
+  static conversion_status from_sql(const char *data, size_t size,
+                                    const MYSQL_FIELD &field,
+                                    Temporal &val) noexcept {
+    if (!data) {
+      return conversion_status::null_value;
+    }
+    switch (field.type) {
+    case MYSQL_TYPE_DATE:
+    case MYSQL_TYPE_NEWDATE:
+    case MYSQL_TYPE_DATETIME:
+    case MYSQL_TYPE_TIMESTAMP:
+    case MYSQL_TYPE_TIME:
+      break;
+    default:
+      return conversion_status::unsupported_column_type;
+    }
+    MYSQL_TIME time;
+    if (!detail::parse_mysql_time(data, size, time) ||
+        !detail::from_mysql_time(time, val)) {
+      return conversion_status::failed;
+    }
+    return conversion_status::ok;
+  }
+};
+
+template <size_t N> struct type_converter<std::bitset<N>> {
+  static void to_sql(sql_writer &out, const std::bitset<N> &val) {
+    std::string bytes;
+    detail::bitset_to_bytes(val, bytes);
+    out.write_bits(bytes.data(), bytes.size());
+  }
+
+  static conversion_status from_sql(const char *data, size_t size,
+                                    const MYSQL_FIELD &field,
+                                    std::bitset<N> &val) noexcept {
+    if (!data) {
+      return conversion_status::null_value;
+    }
+    if (field.type != MYSQL_TYPE_BIT) {
+      return conversion_status::unsupported_column_type;
+    }
+    return detail::bitset_from_bytes(data, size, val)
+               ? conversion_status::ok
+               : conversion_status::failed;
+  }
+};
+
+template <typename T>
+struct type_converter<
+    std::optional<T>, typename std::enable_if<is_mariadb_value<T>::value>::type> {
+  static void to_sql(sql_writer &out, const std::optional<T> &val) {
+    if (val) {
+      type_converter<T>::to_sql(out, *val);
+    } else {
+      out.write_null();
+    }
+  }
+
+  static conversion_status from_sql(const char *data, size_t size,
+                                    const MYSQL_FIELD &field,
+                                    std::optional<T> &val) {
+    if (!data) {
+      val.reset();
+      return conversion_status::ok;
+    }
+    if (!val) {
+      val.emplace();
+    }
+    return type_converter<T>::from_sql(data, size, field, *val);
+  }
+};
+
+template <typename T>
+struct type_converter<
+    std::unique_ptr<T>, typename std::enable_if<is_mariadb_value<T>::value>::type> {
+  static void to_sql(sql_writer &out, const std::unique_ptr<T> &val) {
+    if (val) {
+      type_converter<T>::to_sql(out, *val);
+    } else {
+      out.write_null();
+    }
+  }
+
+  static conversion_status from_sql(const char *data, size_t size,
+                                    const MYSQL_FIELD &field,
+                                    std::unique_ptr<T> &val) {
+    if (!data) {
+      val.reset();
+      return conversion_status::ok;
+    }
+    if (!val) {
+      val = std::make_unique<T>();
+    }
+    return type_converter<T>::from_sql(data, size, field, *val);
+  }
+};
+
+} // namespace mariadb
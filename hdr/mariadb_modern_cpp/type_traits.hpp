@@ -0,0 +1,26 @@
+#pragma once
+
+#include <type_traits>
+
+namespace mariadb {
+
+template <typename Test, template <typename...> class Ref>
+struct is_specialization_of : std::false_type {};
+
+template <template <typename...> class Ref, typename... Args>
+struct is_specialization_of<Ref<Args...>, Ref> : std::true_type {};
+
+// The customization point converting between C++ values and sql,see
+// type_converter.hpp for the library's own specializations.
+template <typename Type, typename Enable = void> struct type_converter;
+
+// a type is a mariadb value if it has a type_converter
+template <typename Type, typename Enable = void>
+struct is_mariadb_value : std::false_type {};
+
+template <typename Type>
+struct is_mariadb_value<Type,
+                        std::void_t<decltype(sizeof(type_converter<Type>))>>
+    : std::true_type {};
+
+} // namespace mariadb
@@ -0,0 +1,453 @@
+#pragma once
+
+#if __has_include(<mariadb/mysql.h>)
+#include <mariadb/mysql.h>
+#define USE_MARIADB
+#elif __has_include(<mysql/mysql.h>)
+#include <mysql/mysql.h>
+#define USE_MYSQL
+#else
+#error No mariadb/mysql header found!
+#endif
+
+#include <bitset>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <initializer_list>
+#include <limits>
+#include <string>
+#include <type_traits>
+
+#include "errors.hpp"
+#include "type_traits.hpp"
+
+namespace mariadb {
+
+// A fixed-point number holding DECIMAL columns exactly,as long as they have
+// no more than max_digits significant digits. The scale can reach that of
+// DECIMAL columns,so a DECIMAL(30,25) zero is held too.
+class decimal {
+public:
+  static constexpr unsigned max_digits = 18;
+  // the largest scale of DECIMAL columns
+  static constexpr unsigned max_scale = 38;
+  // sign,decimal point and the digits,which are at most the 19 of the
+  // unscaled value or the scale and a leading zero
+  static constexpr size_t max_chars = max_scale + 3;
+
+  constexpr decimal() noexcept = default;
+  // throws if `scale` exceeds max_scale
+  constexpr decimal(std::int64_t unscaled_value, unsigned scale)
+      : _unscaled_value(unscaled_value), _scale(scale) {
+    if (scale > max_scale) {
+      throw mariadb_exception("decimal scale exceeds max_scale");
+    }
+  }
+
+  constexpr std::int64_t unscaled_value() const noexcept {
+    return _unscaled_value;
+  }
+  constexpr unsigned scale() const noexcept { return _scale; }
+
+  double to_double() const noexcept {
+    double value = static_cast<double>(_unscaled_value);
+    for (unsigned i = 0; i < _scale; i++) {
+      value /= 10;
+    }
+    return value;
+  }
+
+  // parses text like "-12.340",returns false if the text is malformed,has
+  // too many significant digits or a scale over max_scale
+  static bool from_chars(const char *first, const char *last,
+                         decimal &value) noexcept {
+    bool negative = false;
+    if (first != last && (*first == '-' || *first == '+')) {
+      negative = (*first == '-');
+      first++;
+    }
+    std::uint64_t unscaled_value = 0;
+    unsigned digits = 0;
+    unsigned scale = 0;
+    bool has_point = false;
+    bool has_digit = false;
+    for (; first != last; first++) {
+      if (*first == '.' && !has_point) {
+        has_point = true;
+        continue;
+      }
+      if (*first < '0' || *first > '9') {
+        return false;
+      }
+      has_digit = true;
+      if (unscaled_value != 0 || *first != '0') {
+        digits++;
+      }
+      if (digits > max_digits) {
+        return false;
+      }
+      unscaled_value =
+          unscaled_value * 10 + static_cast<unsigned>(*first - '0');
+      if (has_point && ++scale > max_scale) {
+        return false;
+      }
+    }
+    if (!has_digit) {
+      return false;
+    }
+    value._unscaled_value = static_cast<std::int64_t>(unscaled_value);
+    if (negative) {
+      value._unscaled_value = -value._unscaled_value;
+    }
+    value._scale = scale;
+    return true;
+  }
+
+  // writes at most max_chars characters and returns the end of them
+  char *to_chars(char *first) const noexcept {
+    char digits[max_chars];
+    auto magnitude = _unscaled_value < 0
+                         ? 0 - static_cast<std::uint64_t>(_unscaled_value)
+                         : static_cast<std::uint64_t>(_unscaled_value);
+    unsigned count = 0;
+    do {
+      digits[count++] = static_cast<char>('0' + magnitude % 10);
+      magnitude /= 10;
+    } while (magnitude != 0 || count <= _scale);
+
+    if (_unscaled_value < 0) {
+      *first++ = '-';
+    }
+    while (count > 0) {
+      if (count == _scale) {
+        *first++ = '.';
+      }
+      *first++ = digits[--count];
+    }
+    return first;
+  }
+
+  std::string to_string() const {
+    char buffer[max_chars];
+    return std::string(buffer, to_chars(buffer));
+  }
+
+  friend bool operator==(const decimal &lhs, const decimal &rhs) noexcept {
+    auto l = lhs._normalized();
+    auto r = rhs._normalized();
+    return l._unscaled_value == r._unscaled_value && l._scale == r._scale;
+  }
+  friend bool operator!=(const decimal &lhs, const decimal &rhs) noexcept {
+    return !(lhs == rhs);
+  }
+
+private:
+  std::int64_t _unscaled_value{};
+  unsigned _scale{};
+
+  decimal _normalized() const noexcept {
+    auto value = *this;
+    while (value._scale > 0 && value._unscaled_value % 10 == 0) {
+      value._unscaled_value /= 10;
+      value._scale--;
+    }
+    return value;
+  }
+};
+
+template <typename Type> struct is_time_point : std::false_type {};
+template <typename Duration>
+struct is_time_point<
+    std::chrono::time_point<std::chrono::system_clock, Duration>>
+    : std::true_type {};
+
+template <typename Type> struct is_duration : std::false_type {};
+template <typename Rep, typename Period>
+struct is_duration<std::chrono::duration<Rep, Period>> : std::true_type {};
+
+template <typename Type> struct is_bitset : std::false_type {};
+template <size_t N> struct is_bitset<std::bitset<N>> : std::true_type {};
+
+namespace detail {
+
+template <typename Type>
+struct is_temporal
+    : std::integral_constant<bool, is_time_point<Type>::value ||
+                                       is_duration<Type>::value> {};
+#if __cplusplus > 201703L
+template <>
+struct is_temporal<std::chrono::year_month_day> : std::true_type {};
+#endif
+
+// see http://howardhinnant.github.io/date_algorithms.html
+constexpr long long days_from_civil(long long y, unsigned m,
+                                    unsigned d) noexcept {
+  y -= m <= 2;
+  const long long era = (y >= 0 ? y : y - 399) / 400;
+  const auto yoe = static_cast<unsigned>(y - era * 400);
+  const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + static_cast<long long>(doe) - 719468;
+}
+
+constexpr void civil_from_days(long long z, long long &y, unsigned &m,
+                               unsigned &d) noexcept {
+  z += 719468;
+  const long long era = (z >= 0 ? z : z - 146096) / 146097;
+  const auto doe = static_cast<unsigned>(z - era * 146097);
+  const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  const unsigned mp = (5 * doy + 2) / 153;
+  d = doy - (153 * mp + 2) / 5 + 1;
+  m = mp < 10 ? mp + 3 : mp - 9;
+  y = static_cast<long long>(yoe) + era * 400 + (m <= 2);
+}
+
+inline bool parse_unsigned(const char *&first, const char *last,
+                           size_t max_digits, unsigned long &value) noexcept {
+  value = 0;
+  size_t digits = 0;
+  while (first != last && *first >= '0' && *first <= '9' &&
+         digits < max_digits) {
+    value = value * 10 + static_cast<unsigned long>(*first - '0');
+    first++;
+    digits++;
+  }
+  return digits != 0;
+}
+
+inline bool parse_fraction(const char *&first, const char *last,
+                           unsigned long &microseconds) noexcept {
+  microseconds = 0;
+  if (first == last || *first != '.') {
+    return true;
+  }
+  first++;
+  unsigned digits = 0;
+  while (first != last && *first >= '0' && *first <= '9') {
+    if (digits < 6) {
+      microseconds =
+          microseconds * 10 + static_cast<unsigned long>(*first - '0');
+    }
+    first++;
+    digits++;
+  }
+  for (; digits < 6; digits++) {
+    microseconds *= 10;
+  }
+  return true;
+}
+
+// parses the text protocol representation of DATE,DATETIME,TIMESTAMP and
+// TIME columns without allocation
+inline bool parse_mysql_time(const char *str, size_t size,
+                             MYSQL_TIME &time) noexcept {
+  time = MYSQL_TIME{};
+  const char *first = str;
+  const char *last = str + size;
+  unsigned long fields[3]{};
+
+  const bool negative = first != last && *first == '-';
+  if (negative) {
+    first++;
+  }
+  const char *start = first;
+  if (!parse_unsigned(first, last, 7, fields[0])) {
+    return false;
+  }
+
+  if (first != last && *first == '-' && !negative && first - start == 4) {
+    // DATE or DATETIME
+    time.year = static_cast<unsigned>(fields[0]);
+    for (auto *field : {&fields[1], &fields[2]}) {
+      if (first == last || *first != '-') {
+        return false;
+      }
+      first++;
+      if (!parse_unsigned(first, last, 2, *field)) {
+        return false;
+      }
+    }
+    time.month = static_cast<unsigned>(fields[1]);
+    time.day = static_cast<unsigned>(fields[2]);
+    time.time_type = MYSQL_TIMESTAMP_DATE;
+    if (first == last) {
+      return true;
+    }
+    if (*first != ' ' && *first != 'T') {
+      return false;
+    }
+    first++;
+    if (!parse_unsigned(first, last, 2, fields[0])) {
+      return false;
+    }
+    time.time_type = MYSQL_TIMESTAMP_DATETIME;
+  } else {
+    time.time_type = MYSQL_TIMESTAMP_TIME;
+    time.neg = negative;
+  }
+
+  time.hour = static_cast<unsigned>(fields[0]);
+  for (auto *field : {&fields[1], &fields[2]}) {
+    if (first == last || *first != ':') {
+      return false;
+    }
+    first++;
+    if (!parse_unsigned(first, last, 2, *field)) {
+      return false;
+    }
+  }
+  time.minute = static_cast<unsigned>(fields[1]);
+  time.second = static_cast<unsigned>(fields[2]);
+  parse_fraction(first, last, time.second_part);
+  return first == last;
+}
+
+// formats like the text protocol and returns the number of written
+// characters,the buffer must hold at least 32 characters
+inline size_t format_mysql_time(const MYSQL_TIME &time,
+                                char *buffer) noexcept {
+  int n = 0;
+  switch (time.time_type) {
+  case MYSQL_TIMESTAMP_DATE:
+    n = std::snprintf(buffer, 32, "%04u-%02u-%02u", time.year, time.month,
+                      time.day);
+    break;
+  case MYSQL_TIMESTAMP_TIME:
+    n = std::snprintf(buffer, 32, "%s%02u:%02u:%02u.%06lu",
+                      time.neg ? "-" : "", time.day * 24 + time.hour,
+                      time.minute, time.second, time.second_part);
+    break;
+  default:
+    n = std::snprintf(buffer, 32, "%04u-%02u-%02u %02u:%02u:%02u.%06lu",
+                      time.year, time.month, time.day, time.hour, time.minute,
+                      time.second, time.second_part);
+    break;
+  }
+  return static_cast<size_t>(n);
+}
+
+template <typename Result>
+bool from_mysql_time(const MYSQL_TIME &time, Result &val) noexcept {
+  using namespace std::chrono;
+  using days_type = duration<long long, std::ratio<86400>>;
+  if constexpr (is_time_point<Result>::value) {
+    if (time.time_type != MYSQL_TIMESTAMP_DATE &&
+        time.time_type != MYSQL_TIMESTAMP_DATETIME) {
+      return false;
+    }
+    if (time.month == 0 || time.day == 0) {
+      return false;
+    }
+    const auto since_epoch =
+        days_type(days_from_civil(time.year, time.month, time.day)) +
+        hours(time.hour) + minutes(time.minute) + seconds(time.second) +
+        microseconds(time.second_part);
+    val = Result(floor<typename Result::duration>(since_epoch));
+    return true;
+  } else if constexpr (is_duration<Result>::value) {
+    if (time.time_type != MYSQL_TIMESTAMP_TIME) {
+      return false;
+    }
+    const auto value = hours(time.day * 24 + time.hour) +
+                       minutes(time.minute) + seconds(time.second) +
+                       microseconds(time.second_part);
+    val = duration_cast<Result>(time.neg ? -value : value);
+    return true;
+#if __cplusplus > 201703L
+  } else if constexpr (std::is_same_v<Result, year_month_day>) {
+    if (time.time_type != MYSQL_TIMESTAMP_DATE &&
+        time.time_type != MYSQL_TIMESTAMP_DATETIME) {
+      return false;
+    }
+    val = year_month_day(year(static_cast<int>(time.year)), month(time.month),
+                         day(time.day));
+    return val.ok();
+#endif
+  } else {
+    return false;
+  }
+}
+
+template <typename Value>
+MYSQL_TIME to_mysql_time(const Value &val) noexcept {
+  using namespace std::chrono;
+  using days_type = duration<long long, std::ratio<86400>>;
+  MYSQL_TIME time{};
+  if constexpr (is_time_point<Value>::value) {
+    const auto since_epoch = floor<microseconds>(val.time_since_epoch());
+    const auto days = floor<days_type>(since_epoch);
+    long long y{};
+    civil_from_days(days.count(), y, time.month, time.day);
+    time.year = static_cast<unsigned>(y);
+    auto rest = since_epoch - days;
+    time.hour = static_cast<unsigned>(duration_cast<hours>(rest).count());
+    rest -= hours(time.hour);
+    time.minute = static_cast<unsigned>(duration_cast<minutes>(rest).count());
+    rest -= minutes(time.minute);
+    time.second = static_cast<unsigned>(duration_cast<seconds>(rest).count());
+    rest -= seconds(time.second);
+    time.second_part = static_cast<unsigned long>(rest.count());
+    time.time_type = MYSQL_TIMESTAMP_DATETIME;
+  } else if constexpr (is_duration<Value>::value) {
+    auto value = duration_cast<microseconds>(val);
+    if (value.count() < 0) {
+      time.neg = 1;
+      value = -value;
+    }
+    const auto total_hours = duration_cast<hours>(value);
+    value -= total_hours;
+    time.day = static_cast<unsigned>(total_hours.count() / 24);
+    time.hour = static_cast<unsigned>(total_hours.count() % 24);
+    time.minute = static_cast<unsigned>(duration_cast<minutes>(value).count());
+    value -= minutes(time.minute);
+    time.second = static_cast<unsigned>(duration_cast<seconds>(value).count());
+    value -= seconds(time.second);
+    time.second_part = static_cast<unsigned long>(value.count());
+    time.time_type = MYSQL_TIMESTAMP_TIME;
+#if __cplusplus > 201703L
+  } else if constexpr (std::is_same_v<Value, year_month_day>) {
+    time.year = static_cast<unsigned>(static_cast<int>(val.year()));
+    time.month = static_cast<unsigned>(val.month());
+    time.day = static_cast<unsigned>(val.day());
+    time.time_type = MYSQL_TIMESTAMP_DATE;
+#endif
+  }
+  return time;
+}
+
+// BIT columns arrive as big-endian bytes
+template <size_t N>
+bool bitset_from_bytes(const char *data, size_t size,
+                       std::bitset<N> &val) noexcept {
+  val.reset();
+  for (size_t i = 0; i < size; i++) {
+    const auto byte = static_cast<unsigned char>(data[size - 1 - i]);
+    for (size_t bit = 0; bit < 8; bit++) {
+      if (!(byte & (1u << bit))) {
+        continue;
+      }
+      if (i * 8 + bit >= N) {
+        return false;
+      }
+      val.set(i * 8 + bit);
+    }
+  }
+  return true;
+}
+
+template <size_t N>
+void bitset_to_bytes(const std::bitset<N> &val, std::string &out) {
+  const size_t size = (N + 7) / 8;
+  const size_t start = out.size();
+  out.append(size, '\0');
+  for (size_t i = 0; i < N; i++) {
+    if (val.test(i)) {
+      out[start + size - 1 - i / 8] |= static_cast<char>(1u << (i % 8));
+    }
+  }
+}
+
+} // namespace detail
+} // namespace mariadb
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace mariadb {
+namespace utility {
+
+// A bounded lock-free multi-producer multi-consumer queue,see
+// https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+template <typename T> class bounded_ring {
+public:
+  // the capacity is rounded up to a power of two
+  explicit bounded_ring(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) {
+      size *= 2;
+    }
+    _mask = size - 1;
+    _cells = std::make_unique<cell[]>(size);
+    for (size_t i = 0; i < size; i++) {
+      _cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  bounded_ring(const bounded_ring &) = delete;
+  bounded_ring &operator=(const bounded_ring &) = delete;
+
+  size_t capacity() const noexcept { return _mask + 1; }
+
+  // moves from `value` only on success
+  bool try_push(T &value) {
+    cell *c = nullptr;
+    auto pos = _enqueue_pos.load(std::memory_order_relaxed);
+    while (true) {
+      c = &_cells[pos & _mask];
+      const auto seq = c->sequence.load(std::memory_order_acquire);
+      const auto diff =
+          static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+      if (diff == 0) {
+        if (_enqueue_pos.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = _enqueue_pos.load(std::memory_order_relaxed);
+      }
+    }
+    c->value = std::move(value);
+    c->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool try_pop(T &value) {
+    cell *c = nullptr;
+    auto pos = _dequeue_pos.load(std::memory_order_relaxed);
+    while (true) {
+      c = &_cells[pos & _mask];
+      const auto seq = c->sequence.load(std::memory_order_acquire);
+      const auto diff = static_cast<std::intptr_t>(seq) -
+                        static_cast<std::intptr_t>(pos + 1);
+      if (diff == 0) {
+        if (_dequeue_pos.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = _dequeue_pos.load(std::memory_order_relaxed);
+      }
+    }
+    value = std::move(c->value);
+    c->sequence.store(pos + _mask + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  struct cell {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  std::unique_ptr<cell[]> _cells;
+  size_t _mask{};
+  alignas(64) std::atomic<size_t> _enqueue_pos{0};
+  alignas(64) std::atomic<size_t> _dequeue_pos{0};
+};
+
+} // namespace utility
+} // namespace mariadb
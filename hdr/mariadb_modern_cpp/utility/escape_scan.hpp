@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MARIADB_MODERN_CPP_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace mariadb {
+namespace utility {
+
+// the bytes mysql_real_escape_string escapes with backslashes
+constexpr bool needs_escape(unsigned char c) noexcept {
+  return c == '\0' || c == '\n' || c == '\r' || c == '\\' || c == '\'' ||
+         c == '"' || c == '\032';
+}
+
+namespace detail {
+
+inline unsigned lowest_bit(uint32_t mask) noexcept {
+#if defined(_MSC_VER)
+  unsigned long idx{};
+  _BitScanForward(&idx, mask);
+  return static_cast<unsigned>(idx);
+#else
+  return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+// nonzero if a byte of `word` equals `c`
+constexpr uint64_t has_byte(uint64_t word, unsigned char c) noexcept {
+  constexpr uint64_t ones = 0x0101010101010101ULL;
+  const uint64_t x = word ^ (ones * c);
+  return (x - ones) & ~x & (ones << 7);
+}
+
+} // namespace detail
+
+// The offset of the first byte needing escape in `data`,or `size` if there
+// is none. Checks 32 bytes at a time with AVX2,16 with SSE2 and 8 otherwise.
+inline size_t find_escape(const char *data, size_t size) noexcept {
+  size_t i = 0;
+#if defined(__AVX2__)
+  {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i quote = _mm256_set1_epi8('\'');
+    const __m256i double_quote = _mm256_set1_epi8('"');
+    const __m256i ctrl_z = _mm256_set1_epi8('\032');
+    for (; i + 32 <= size; i += 32) {
+      const __m256i v =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+      __m256i m = _mm256_cmpeq_epi8(v, zero);
+      m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, lf));
+      m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, cr));
+      m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, backslash));
+      m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, quote));
+      m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, double_quote));
+      m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, ctrl_z));
+      const auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(m));
+      if (mask != 0) {
+        return i + detail::lowest_bit(mask);
+      }
+    }
+  }
+#endif
+#if defined(MARIADB_MODERN_CPP_SSE2)
+  {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i quote = _mm_set1_epi8('\'');
+    const __m128i double_quote = _mm_set1_epi8('"');
+    const __m128i ctrl_z = _mm_set1_epi8('\032');
+    for (; i + 16 <= size; i += 16) {
+      const __m128i v =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+      __m128i m = _mm_cmpeq_epi8(v, zero);
+      m = _mm_or_si128(m, _mm_cmpeq_epi8(v, lf));
+      m = _mm_or_si128(m, _mm_cmpeq_epi8(v, cr));
+      m = _mm_or_si128(m, _mm_cmpeq_epi8(v, backslash));
+      m = _mm_or_si128(m, _mm_cmpeq_epi8(v, quote));
+      m = _mm_or_si128(m, _mm_cmpeq_epi8(v, double_quote));
+      m = _mm_or_si128(m, _mm_cmpeq_epi8(v, ctrl_z));
+      const auto mask = static_cast<uint32_t>(_mm_movemask_epi8(m));
+      if (mask != 0) {
+        return i + detail::lowest_bit(mask);
+      }
+    }
+  }
+#endif
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word{};
+    std::memcpy(&word, data + i, sizeof(word));
+    if ((detail::has_byte(word, '\0') | detail::has_byte(word, '\n') |
+         detail::has_byte(word, '\r') | detail::has_byte(word, '\\') |
+         detail::has_byte(word, '\'') | detail::has_byte(word, '"') |
+         detail::has_byte(word, '\032')) != 0) {
+      break;
+    }
+  }
+  for (; i < size; i++) {
+    if (needs_escape(static_cast<unsigned char>(data[i]))) {
+      return i;
+    }
+  }
+  return size;
+}
+
+} // namespace utility
+} // namespace mariadb
+
+#undef MARIADB_MODERN_CPP_SSE2
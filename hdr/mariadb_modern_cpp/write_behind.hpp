@@ -0,0 +1,368 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "../mariadb_modern_cpp.hpp"
+#include "utility/bounded_ring.hpp"
+
+namespace mariadb {
+
+// what push() does when the queue is full
+enum class overflow_policy {
+  // waits for the writer to make room
+  block,
+  // drops the pushed row
+  drop_newest,
+  // drops the oldest queued row to make room
+  drop_oldest,
+};
+
+struct write_behind_options {
+  // rows queued at most,rounded up to a power of two
+  size_t capacity{64 * 1024};
+  overflow_policy overflow{overflow_policy::block};
+  // rows and statement bytes of one multi-row INSERT,keep the bytes below
+  // max_allowed_packet
+  size_t max_batch_rows{1000};
+  size_t max_batch_bytes{1024 * 1024};
+  // queued rows are written at least this often
+  std::chrono::milliseconds flush_interval{100};
+  // after a server error,the rows of a failed INSERT are inserted again one
+  // by one,so that only the rows causing the error fail. Only for tables
+  // which roll back a failed statement,like InnoDB ones,or rows inserted
+  // before the error are written twice.
+  bool retry_rows{false};
+};
+
+struct write_behind_stats {
+  // rows pushed
+  uint64_t accepted{};
+  // rows waiting to be written,including those being pushed
+  uint64_t queued{};
+  uint64_t flushed{};
+  // rows of INSERTs which failed,and weren't written by a retry
+  uint64_t failed{};
+  // rows dropped by the overflow policy
+  uint64_t dropped{};
+  // INSERT statements executed
+  uint64_t batches{};
+};
+
+// Inserts rows into `table` from a thread of its own on a dedicated
+// connection,so that push() doesn't wait for a round trip. Rows from any
+// number of threads go through a lock-free queue,and are written as
+// multi-row INSERTs once max_batch_rows are queued or flush_interval has
+// passed. The rows still queued are written by the destructor.
+template <typename... Types> class write_behind {
+public:
+  using row_type = std::tuple<Types...>;
+  // called from the writer thread with an error and the rows which failed
+  // by it
+  using error_handler = std::function<void(const mariadb_exception &,
+                                           const std::vector<row_type> &)>;
+
+  write_behind(const mariadb_config &config, std::string table,
+               std::vector<std::string> columns,
+               write_behind_options options = {},
+               error_handler on_error = {})
+      : _config(config), _options(std::move(options)),
+        _on_error(std::move(on_error)),
+        _ring(std::max<size_t>(_options.capacity, 1)),
+        _db(std::make_unique<database>(_config)) {
+    if (columns.size() != sizeof...(Types)) {
+      throw mariadb_exception("write_behind needs " +
+                              std::to_string(sizeof...(Types)) + " columns");
+    }
+    // a full queue is written at once
+    _batch_rows = std::clamp<size_t>(_options.max_batch_rows, 1,
+                                     _ring.capacity());
+    _insert_prefix = "INSERT INTO " + table + " (";
+    for (size_t i = 0; i < columns.size(); i++) {
+      _insert_prefix.append(i == 0 ? "" : ",").append(columns[i]);
+    }
+    _insert_prefix.append(") VALUES ");
+    _thread = std::thread([this] { _run(); });
+  }
+
+  write_behind(const write_behind &) = delete;
+  write_behind &operator=(const write_behind &) = delete;
+
+  ~write_behind() {
+    {
+      std::lock_guard lk(_mtx);
+      _stop = true;
+    }
+    _writer_cv.notify_all();
+    _thread.join();
+  }
+
+  // Queues a row,returns false if it was dropped by
+  // overflow_policy::drop_newest
+  template <typename... Values> bool push(Values &&... values) {
+    row_type row(std::forward<Values>(values)...);
+    // counted first,so the writer never sees more rows than queued
+    const auto queued = _queued.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (!_ring.try_push(row)) {
+      switch (_options.overflow) {
+      case overflow_policy::drop_newest:
+        _queued.fetch_sub(1, std::memory_order_relaxed);
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      case overflow_policy::drop_oldest: {
+        row_type oldest;
+        do {
+          if (_ring.try_pop(oldest)) {
+            _queued.fetch_sub(1, std::memory_order_relaxed);
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            _add_settled(1);
+          }
+        } while (!_ring.try_push(row));
+        break;
+      }
+      case overflow_policy::block: {
+        std::unique_lock lk(_mtx);
+        _writer_cv.notify_one();
+        _space_cv.wait(lk, [&] { return _ring.try_push(row); });
+        break;
+      }
+      }
+    }
+    _accepted.fetch_add(1, std::memory_order_relaxed);
+    if (queued == _batch_rows) {
+      // under the lock,so the writer can't miss it between its check and
+      // its wait
+      std::lock_guard lk(_mtx);
+      _writer_cv.notify_one();
+    }
+    return true;
+  }
+
+  // returns once the rows pushed before are written or failed
+  void flush() {
+    const auto target = _accepted.load(std::memory_order_relaxed);
+    std::unique_lock lk(_mtx);
+    _flush_target = std::max(_flush_target, target);
+    _writer_cv.notify_one();
+    _settled_cv.wait(lk, [&] {
+      return _settled.load(std::memory_order_relaxed) >= target;
+    });
+  }
+
+  write_behind_stats stats() const noexcept {
+    write_behind_stats s;
+    s.accepted = _accepted.load(std::memory_order_relaxed);
+    s.flushed = _flushed.load(std::memory_order_relaxed);
+    s.failed = _failed.load(std::memory_order_relaxed);
+    s.dropped = _dropped.load(std::memory_order_relaxed);
+    s.batches = _batches.load(std::memory_order_relaxed);
+    s.queued = _queued.load(std::memory_order_relaxed);
+    return s;
+  }
+
+private:
+  void _run() {
+    init_thread();
+    std::vector<row_type> rows;
+    auto deadline = std::chrono::steady_clock::now() + _options.flush_interval;
+    while (true) {
+      bool stop{};
+      bool flushing{};
+      {
+        std::unique_lock lk(_mtx);
+        _writer_cv.wait_until(lk, deadline, [&] {
+          flushing = _settled.load(std::memory_order_relaxed) < _flush_target;
+          return _stop || flushing ||
+                 _queued.load(std::memory_order_relaxed) >= _batch_rows;
+        });
+        stop = _stop;
+      }
+      // while a flush waits,all rows queued are written,otherwise one batch
+      // at a time. a pass can stop short at a row still being pushed,the
+      // next one goes on until the flush target is settled
+      const bool forced = stop || flushing;
+      const auto limit =
+          forced ? _queued.load(std::memory_order_relaxed) : _batch_rows;
+      row_type row;
+      while (rows.size() < limit && _ring.try_pop(row)) {
+        rows.push_back(std::move(row));
+      }
+      if (!rows.empty()) {
+        _queued.fetch_sub(rows.size(), std::memory_order_relaxed);
+        {
+          std::lock_guard lk(_mtx);
+        }
+        _space_cv.notify_all();
+        _write(rows);
+        rows.clear();
+      }
+      deadline = std::chrono::steady_clock::now() + _options.flush_interval;
+      if (stop) {
+        break;
+      }
+    }
+  }
+
+  // splits the rows into INSERTs of at most max_batch_rows rows and
+  // max_batch_bytes bytes,unless a single row is larger
+  void _write(const std::vector<row_type> &rows) {
+    std::string sql;
+    size_t first = 0;
+    for (size_t i = 0; i < rows.size(); i++) {
+      const auto row_start = sql.size();
+      if (i == first) {
+        sql.append(_insert_prefix);
+      } else {
+        sql.push_back(',');
+      }
+      if (!_connect(rows, first, rows.size())) {
+        return;
+      }
+      _append_row(sql, rows[i]);
+      if (i > first && (sql.size() > _options.max_batch_bytes ||
+                        i - first == _batch_rows)) {
+        // the row goes to the next statement
+        sql.resize(row_start);
+        _execute(sql, rows, first, i);
+        sql.clear();
+        first = i;
+        i--;
+      }
+    }
+    if (first < rows.size()) {
+      _execute(sql, rows, first, rows.size());
+    }
+  }
+
+  // needs the connection to escape the strings
+  void _append_row(std::string &sql, const row_type &row) {
+    sql_writer writer(_db->handle().get(), sql);
+    sql.push_back('(');
+    std::apply(
+        [&](const auto &... values) {
+          size_t idx = 0;
+          ((idx++ == 0 ? void() : sql.push_back(','),
+            type_converter<std::decay_t<decltype(values)>>::to_sql(writer,
+                                                                   values)),
+           ...);
+        },
+        row);
+    sql.push_back(')');
+  }
+
+  // executes the INSERT of rows [first,last)
+  void _execute(const std::string &sql, const std::vector<row_type> &rows,
+                size_t first, size_t last) {
+    if (!_connect(rows, first, last)) {
+      return;
+    }
+    MYSQL *db = _db->handle().get();
+    if (mysql_real_query(db, sql.data(), sql.size()) == 0) {
+      _batches.fetch_add(1, std::memory_order_relaxed);
+      _settle(last - first, 0);
+      return;
+    }
+    const mariadb_exception e(db);
+    if (e.get_errno() >= CR_MIN_ERROR) {
+      // reconnect for the next batch
+      _db.reset();
+    } else if (_options.retry_rows && last - first > 1) {
+      std::string row_sql;
+      for (size_t i = first; i < last; i++) {
+        if (!_connect(rows, i, last)) {
+          return;
+        }
+        row_sql = _insert_prefix;
+        _append_row(row_sql, rows[i]);
+        _execute(row_sql, rows, i, i + 1);
+      }
+      return;
+    }
+    _fail(e, rows, first, last);
+  }
+
+  // connects if needed,or fails rows [first,last)
+  bool _connect(const std::vector<row_type> &rows, size_t first,
+                size_t last) {
+    if (_db) {
+      return true;
+    }
+    try {
+      _db = std::make_unique<database>(_config);
+      return true;
+    } catch (const mariadb_exception &e) {
+      _fail(e, rows, first, last);
+      return false;
+    }
+  }
+
+  // reports and counts the failed rows [first,last)
+  void _fail(const mariadb_exception &e, const std::vector<row_type> &rows,
+             size_t first, size_t last) noexcept {
+    if (_on_error) {
+      try {
+        _on_error(e, std::vector<row_type>(
+                         rows.begin() + static_cast<std::ptrdiff_t>(first),
+                         rows.begin() + static_cast<std::ptrdiff_t>(last)));
+      } catch (...) {
+      }
+    }
+    _settle(0, last - first);
+  }
+
+  void _settle(size_t flushed, size_t failed) noexcept {
+    _flushed.fetch_add(flushed, std::memory_order_relaxed);
+    _failed.fetch_add(failed, std::memory_order_relaxed);
+    _add_settled(flushed + failed);
+  }
+
+  // wakes flush() whenever rows are settled,by any pass or by drop_oldest
+  void _add_settled(size_t rows) noexcept {
+    _settled.fetch_add(rows, std::memory_order_relaxed);
+    {
+      std::lock_guard lk(_mtx);
+    }
+    _settled_cv.notify_all();
+  }
+
+  mariadb_config _config;
+  write_behind_options _options;
+  error_handler _on_error;
+  std::string _insert_prefix;
+  size_t _batch_rows{};
+  utility::bounded_ring<row_type> _ring;
+  // used by the writer thread only
+  std::unique_ptr<database> _db;
+
+  std::mutex _mtx;
+  std::condition_variable _writer_cv;
+  std::condition_variable _space_cv;
+  std::condition_variable _settled_cv;
+  bool _stop{false};
+  // the highest _settled count a flush() waits for
+  uint64_t _flush_target{0};
+
+  std::atomic<uint64_t> _accepted{0};
+  std::atomic<uint64_t> _queued{0};
+  std::atomic<uint64_t> _flushed{0};
+  std::atomic<uint64_t> _failed{0};
+  std::atomic<uint64_t> _dropped{0};
+  std::atomic<uint64_t> _batches{0};
+  // rows written,failed or dropped from the queue
+  std::atomic<uint64_t> _settled{0};
+  std::thread _thread;
+};
+
+} // namespace mariadb
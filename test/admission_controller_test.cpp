@@ -0,0 +1,125 @@
+/*!
+ * \file admission_controller_test.cpp
+ *
+ * \date 2026-10-18
+ */
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <doctest.h>
+
+#include "../hdr/mariadb_modern_cpp.hpp"
+#include "test_config.hpp"
+
+TEST_CASE("admission queue") {
+  mariadb::admission_options options;
+  options.initial_limit = options.min_limit = options.max_limit = 1;
+  options.max_queue = 1;
+  options.queue_timeout = std::chrono::seconds(5);
+  mariadb::admission_controller controller(options);
+
+  auto first = controller.admit();
+  REQUIRE(first);
+
+  SUBCASE("timeout") {
+    auto res = controller.admit(mariadb::admission_priority::normal,
+                                std::chrono::milliseconds(20));
+    REQUIRE(!res);
+    CHECK(res.error().kind() == mariadb::error_kind::overloaded);
+    CHECK_THROWS_AS(res.error().raise(), mariadb::exceptions::overloaded);
+    CHECK(controller.stats().rejected_timeout == 1);
+  }
+
+  SUBCASE("priorities") {
+    std::atomic<int> batch_result{-1};
+    std::thread batch([&] {
+      batch_result = controller.admit(mariadb::admission_priority::batch) ? 1
+                                                                          : 0;
+    });
+    while (controller.stats().queued == 0) {
+      std::this_thread::yield();
+    }
+    // the queue is full,but the batch statement gives way
+    std::atomic<int> critical_result{-1};
+    std::thread critical([&] {
+      auto res = controller.admit(mariadb::admission_priority::critical);
+      critical_result = res ? 1 : 0;
+    });
+    batch.join();
+    CHECK(batch_result == 0);
+    // a normal statement can't displace the critical one
+    CHECK(!controller.admit());
+    first->release();
+    critical.join();
+    CHECK(critical_result == 1);
+
+    const auto stats = controller.stats();
+    CHECK(stats.rejected_full == 2);
+    CHECK(stats.admitted == 2);
+    CHECK(stats.in_flight == 0);
+    CHECK(stats.limit == 1);
+  }
+}
+
+TEST_CASE("admission of statements") {
+  mariadb::admission_options options;
+  options.initial_limit = options.min_limit = options.max_limit = 2;
+  options.max_queue = 2;
+  options.queue_timeout = std::chrono::seconds(5);
+  mariadb::admission_controller controller(options);
+
+  std::atomic<int> rejected{0};
+  std::atomic<int> connected{0};
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; i++) {
+    threads.emplace_back([&] {
+      mariadb::database db(get_test_config());
+      db.use_admission(&controller);
+      // all statements start at once
+      connected++;
+      while (connected < 8) {
+        std::this_thread::yield();
+      }
+      auto res = db.statement("select sleep(0.2)").try_execute();
+      if (!res) {
+        CHECK(res.error().kind() == mariadb::error_kind::overloaded);
+        rejected++;
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  const auto stats = controller.stats();
+  CHECK(rejected > 0);
+  CHECK(stats.rejected_full == static_cast<uint64_t>(rejected.load()));
+  CHECK(stats.admitted + stats.rejected_full == 8);
+  CHECK(stats.in_flight == 0);
+  CHECK(stats.long_latency >= std::chrono::milliseconds(100));
+}
+
+TEST_CASE("admission wait counts against the deadline") {
+  mariadb::admission_options options;
+  options.initial_limit = options.min_limit = options.max_limit = 1;
+  options.queue_timeout = std::chrono::seconds(5);
+  mariadb::admission_controller controller(options);
+  mariadb::database db(get_test_config());
+
+  auto first = controller.admit();
+  REQUIRE(first);
+  std::thread releaser([&] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    first->release();
+  });
+  // admitted after about 150ms,which leaves about 50ms for the query
+  const auto start = std::chrono::steady_clock::now();
+  auto stmt = db.statement("select benchmark(100000000000,md5('x'))");
+  stmt.admission(controller).deadline(std::chrono::milliseconds(200));
+  auto res = stmt.try_execute();
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  releaser.join();
+  REQUIRE(!res);
+  CHECK(res.error().kind() == mariadb::error_kind::deadline_exceeded);
+  CHECK(elapsed < std::chrono::milliseconds(300));
+}
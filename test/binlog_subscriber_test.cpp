@@ -0,0 +1,75 @@
+/*!
+ * \file binlog_subscriber_test.cpp
+ *
+ * \brief needs a server with log_bin and binlog_format=ROW,and the
+ * REPLICATION SLAVE privilege for the test user
+ * \date 2026-10-18
+ */
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <cstddef>
+#include <doctest.h>
+
+#include "../hdr/mariadb_modern_cpp/binlog_subscriber.hpp"
+#include "test_config.hpp"
+
+TEST_CASE("binlog_subscriber") {
+  mariadb::database test_db(get_test_config());
+  int64_t log_bin = 0;
+  test_db << "select @@global.log_bin" >> log_bin;
+  if (!log_bin) {
+    MESSAGE("binary log disabled,skipped");
+    return;
+  }
+
+  test_db << "CREATE TABLE IF NOT EXISTS mariadb_modern_cpp_test.tmp_table "
+             "(id BIGINT PRIMARY KEY, name VARCHAR(20));";
+  std::string start;
+  test_db << "select @@global.gtid_binlog_pos" >> start;
+  test_db << "insert into tmp_table values (1,'a'),(2,'b');";
+  test_db << "update tmp_table set name='c' where id=2;";
+  test_db << "delete from tmp_table where id=1;";
+
+  mariadb::binlog_subscriber_options options;
+  options.server_id = 4242;
+  options.tables = {"mariadb_modern_cpp_test.tmp_table"};
+  options.start_position = start;
+  options.batch_size = 2;
+  options.max_delay = std::chrono::milliseconds(50);
+
+  std::vector<mariadb::binlog_change> changes;
+  std::string position;
+  {
+    mariadb::binlog_subscriber subscriber(get_test_config(), options);
+    subscriber.run([&](mariadb::binlog_batch &batch) {
+      for (auto &change : batch.changes) {
+        changes.push_back(std::move(change));
+      }
+      position = batch.position;
+      return changes.size() < 4;
+    });
+  }
+  REQUIRE(changes.size() == 4);
+  CHECK(changes[0].type == mariadb::change_type::inserted);
+  CHECK(changes[0].table == "tmp_table");
+  CHECK(changes[0].after.as<int64_t, std::string>() ==
+        std::make_tuple(int64_t(1), std::string("a")));
+  CHECK(changes[2].type == mariadb::change_type::updated);
+  CHECK(changes[2].before.get<std::string>(1) == "b");
+  CHECK(changes[2].after.get<std::string>(1) == "c");
+  CHECK(changes[3].type == mariadb::change_type::deleted);
+  CHECK(changes[3].before.get<int64_t>(0) == 1);
+  CHECK(changes[3].after.empty());
+
+  SUBCASE("resume after the last batch") {
+    test_db << "insert into tmp_table values (3,'d');";
+    options.start_position = position;
+    mariadb::binlog_subscriber subscriber(get_test_config(), options);
+    subscriber.run([&](mariadb::binlog_batch &batch) {
+      REQUIRE(batch.changes.size() == 1);
+      CHECK(batch.changes[0].after.get<int64_t>(0) == 3);
+      return false;
+    });
+  }
+
+  test_db << "drop TABLE mariadb_modern_cpp_test.tmp_table;";
+}
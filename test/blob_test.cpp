@@ -0,0 +1,107 @@
+/*!
+ * \file blob_test.cpp
+ *
+ * \date 2026-10-18
+ */
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <cstddef>
+#include <cstring>
+#include <doctest.h>
+#include <stdexcept>
+
+#include "../hdr/mariadb_modern_cpp.hpp"
+#include "test_config.hpp"
+
+TEST_CASE("blob") {
+  mariadb::database test_db(get_test_config());
+
+  test_db << "CREATE TABLE IF NOT EXISTS mariadb_modern_cpp_test.tmp_table "
+             "(name VARCHAR(10), data LONGBLOB);";
+
+  // larger than a chunk so that both directions need several round trips
+  std::vector<std::byte> blob(3 * 1024 + 17);
+  for (size_t i = 0; i < blob.size(); i++) {
+    blob[i] = static_cast<std::byte>(i % 251);
+  }
+
+  SUBCASE("stream in and out") {
+    size_t read_offset = 0;
+    test_db.prepare("INSERT INTO tmp_table VALUES (?,?)")
+        << "stream"
+        << mariadb::blob_source(
+               [&](std::byte *buffer, size_t size) {
+                 auto n = std::min(size, blob.size() - read_offset);
+                 std::memcpy(buffer, blob.data() + read_offset, n);
+                 read_offset += n;
+                 return n;
+               },
+               1024);
+    CHECK(read_offset == blob.size());
+
+    std::vector<std::byte> out;
+    size_t chunk_count = 0;
+    test_db.prepare("select data from tmp_table where name=?") << "stream" >>
+        mariadb::blob_sink(
+            [&](const std::byte *data, size_t size) {
+              out.insert(out.end(), data, data + size);
+              chunk_count++;
+            },
+            1024);
+    CHECK(out == blob);
+    CHECK(chunk_count == 4);
+  }
+
+  SUBCASE("failed blob_source") {
+    auto stmt = test_db.prepare("INSERT INTO tmp_table VALUES (?,?)");
+    bool sent = false;
+    stmt << "failed"
+         << mariadb::blob_source([&](std::byte *buffer, size_t size) {
+              if (sent) {
+                throw std::runtime_error("read failed");
+              }
+              sent = true;
+              std::memset(buffer, 1, size);
+              return size;
+            });
+    CHECK_THROWS_AS(stmt.execute(), std::runtime_error);
+
+    // the chunk sent before isn't prepended to the next execution
+    stmt.reuse();
+    stmt << "retried" << blob;
+    stmt.execute();
+    std::vector<std::byte> out;
+    test_db.prepare("select data from tmp_table where name=?") << "retried" >>
+        out;
+    CHECK(out == blob);
+  }
+
+  SUBCASE("blob column in callback") {
+    test_db.prepare("INSERT INTO tmp_table VALUES (?,?)") << "vector" << blob;
+
+    test_db.prepare("select name,data from tmp_table where name=?")
+            << "vector" >>
+        [&](std::string name, mariadb::blob_column data) {
+          CHECK(name == "vector");
+          CHECK(data.size() == blob.size());
+          std::vector<std::byte> out;
+          data.read(
+              [&](const std::byte *piece, size_t size) {
+                out.insert(out.end(), piece, piece + size);
+              },
+              100);
+          CHECK(out == blob);
+        };
+  }
+
+  SUBCASE("extract by prepared statement") {
+    test_db.prepare("INSERT INTO tmp_table VALUES (?,?)")
+        << "vector" << std::optional<std::vector<std::byte>>{};
+
+    size_t count = 0;
+    test_db.prepare("select count(*) from tmp_table where data is null") >>
+        count;
+    CHECK(count == 1);
+  }
+
+  test_db << "drop TABLE mariadb_modern_cpp_test.tmp_table;";
+}
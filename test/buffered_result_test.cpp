@@ -0,0 +1,68 @@
+/*!
+ * \file buffered_result_test.cpp
+ *
+ * \date 2026-10-18
+ */
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+
+#include "../hdr/mariadb_modern_cpp/buffered_result.hpp"
+#include "test_config.hpp"
+
+TEST_CASE("buffered_result") {
+  mariadb::database test_db(get_test_config());
+
+  test_db << "CREATE TABLE IF NOT EXISTS mariadb_modern_cpp_test.tmp_table "
+             "(id BIGINT PRIMARY KEY, name VARCHAR(64));";
+  {
+    auto tc = test_db.get_transaction_context();
+    for (int64_t i = 0; i < 2000; i++) {
+      tc << "insert into tmp_table values (?,?);" << i
+         << (i % 10 ? std::optional<std::string>(std::string(i % 64, 'a'))
+                    : std::nullopt);
+    }
+  }
+
+  SUBCASE("callback runs statements on the connection") {
+    int64_t count = 0;
+    bool same = true;
+    auto info = mariadb::extract_buffered(
+        test_db << "select id,name from tmp_table order by id",
+        [&](int64_t id, std::optional<std::string> name) {
+          int64_t found = 0;
+          test_db << "select count(*) from tmp_table where id=?;" << id >>
+              found;
+          same = same && id == count && found == 1 &&
+                 name.has_value() == (id % 10 != 0) &&
+                 (!name || name->size() == static_cast<size_t>(id % 64));
+          count++;
+        },
+        4096);
+    CHECK(count == 2000);
+    CHECK(same);
+    CHECK(info.rows == 2000);
+    CHECK(info.spilled_rows > 0);
+    CHECK(info.spilled_rows < 2000);
+    CHECK(mariadb::result_memory::used() == 0);
+  }
+
+  SUBCASE("process budget") {
+    mariadb::result_memory::set_budget(0);
+    auto info = mariadb::extract_buffered(
+        test_db << "select id from tmp_table", [](int64_t) {});
+    CHECK(info.spilled_rows == 2000);
+    mariadb::result_memory::set_budget(SIZE_MAX);
+  }
+
+  SUBCASE("conversion errors") {
+    CHECK_THROWS_AS(mariadb::extract_buffered(
+                        test_db << "select name from tmp_table order by id",
+                        [](std::string) {}),
+                    mariadb::exceptions::can_not_hold_null);
+    int64_t found = 0;
+    test_db << "select count(*) from tmp_table;" >> found;
+    CHECK(found == 2000);
+  }
+
+  test_db << "drop TABLE mariadb_modern_cpp_test.tmp_table;";
+}
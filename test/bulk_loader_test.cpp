@@ -0,0 +1,102 @@
+/*!
+ * \file bulk_loader_test.cpp
+ *
+ * \date 2026-10-18
+ */
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <bitset>
+#include <chrono>
+#include <cstddef>
+#include <doctest.h>
+
+#include "../hdr/mariadb_modern_cpp/bulk_loader.hpp"
+#include "test_config.hpp"
+
+TEST_CASE("bulk_loader") {
+  auto config = get_test_config();
+  config.local_infile = true;
+  mariadb::database test_db(config);
+
+  test_db << "CREATE TABLE IF NOT EXISTS mariadb_modern_cpp_test.tmp_table "
+             "(id BIGINT PRIMARY KEY, name TEXT, score DOUBLE);";
+
+  SUBCASE("load tuples") {
+    std::vector<std::tuple<int64_t, std::string, std::optional<double>>> rows;
+    for (int64_t i = 0; i < 10000; i++) {
+      rows.emplace_back(i, "name\t\\\n" + std::to_string(i),
+                        i % 2 ? std::optional<double>(i * 0.5) : std::nullopt);
+    }
+    auto res = mariadb::bulk_loader(test_db).load(
+        "tmp_table", {"id", "name", "score"}, rows);
+    CHECK(res.rows == rows.size());
+    CHECK(res.warnings == 0);
+
+    std::string name;
+    std::optional<double> score;
+    test_db << "select name,score from tmp_table where id=?" << 3 >>
+        std::tie(name, score);
+    CHECK(name == "name\t\\\n3");
+    CHECK(score == 1.5);
+    test_db << "select name,score from tmp_table where id=?" << 4 >>
+        std::tie(name, score);
+    CHECK(!score.has_value());
+  }
+
+  SUBCASE("load structs by projection") {
+    struct person {
+      int64_t id;
+      std::string name;
+    };
+    std::vector<person> people{{1, "bob"}, {2, "jack"}};
+    auto res = mariadb::bulk_loader(test_db).load(
+        "tmp_table", {"id", "name"}, people,
+        [](const person &p) { return std::tie(p.id, p.name); });
+    CHECK(res.rows == 2);
+  }
+
+  SUBCASE("load types through type_converter") {
+    test_db << "CREATE TABLE mariadb_modern_cpp_test.tmp_types (id BIGINT, "
+               "flags BIT(10), at DATETIME, amount DECIMAL(10,2));";
+    using seconds_point = std::chrono::time_point<std::chrono::system_clock,
+                                                  std::chrono::seconds>;
+    // 2024-02-29 13:00:00
+    const seconds_point at(std::chrono::seconds(1709211600));
+    std::vector<std::tuple<int64_t, std::bitset<10>, seconds_point,
+                           mariadb::decimal>>
+        rows{{1, std::bitset<10>("1000000001"), at,
+              mariadb::decimal(-1234, 2)}};
+    auto res = mariadb::bulk_loader(test_db).load(
+        "tmp_types", {"id", "flags", "at", "amount"}, rows);
+    CHECK(res.rows == 1);
+    CHECK(res.warnings == 0);
+
+    std::bitset<10> flags;
+    seconds_point loaded_at;
+    mariadb::decimal amount;
+    test_db << "select flags,at,amount from tmp_types" >>
+        std::tie(flags, loaded_at, amount);
+    CHECK(flags == std::get<1>(rows[0]));
+    CHECK(loaded_at == std::get<2>(rows[0]));
+    CHECK(amount == std::get<3>(rows[0]));
+    test_db << "drop TABLE mariadb_modern_cpp_test.tmp_types;";
+  }
+
+  SUBCASE("sjis connections insert the rows") {
+    test_db << "CREATE TABLE mariadb_modern_cpp_test.tmp_sjis (id BIGINT, "
+               "name TEXT CHARACTER SET sjis);";
+    REQUIRE(mysql_set_character_set(test_db.handle().get(), "sjis") == 0);
+    // the second byte of this character is '\\'
+    const std::string name = "\x95\x5c\t\\";
+    std::vector<std::tuple<int64_t, std::string>> rows{{1, name}, {2, name}};
+    auto res = mariadb::bulk_loader(test_db).load("tmp_sjis", {"id", "name"},
+                                                  rows);
+    CHECK(res.rows == 2);
+
+    std::string loaded;
+    test_db << "select name from tmp_sjis where id=2" >> loaded;
+    CHECK(loaded == name);
+    test_db << "drop TABLE mariadb_modern_cpp_test.tmp_sjis;";
+  }
+
+  test_db << "drop TABLE mariadb_modern_cpp_test.tmp_table;";
+}
@@ -29,3 +29,30 @@ TEST_CASE("connect without passwd") {
   }
   CHECK(has_exception);
 }
+
+TEST_CASE("session initialization") {
+  auto config = get_test_config();
+  config.session_variables = {{"time_zone", "'+00:00'"},
+                              {"sql_mode", "'STRICT_ALL_TABLES'"}};
+  config.warm_statements = {"select ? + 1"};
+  mariadb::database test_db(config);
+
+  std::string time_zone;
+  test_db << "select @@session.time_zone" >> time_zone;
+  CHECK(time_zone == "+00:00");
+
+  int64_t res = 0;
+  test_db.cached_statement("select ? + 1") << 1 >> res;
+  CHECK(res == 2);
+  test_db.cached_statement("select ? + 1") << 2 >> res;
+  CHECK(res == 3);
+
+  SUBCASE("reset restores the session") {
+    test_db << "set session time_zone='+08:00'";
+    test_db.reset();
+    test_db << "select @@session.time_zone" >> time_zone;
+    CHECK(time_zone == "+00:00");
+    test_db.cached_statement("select ? + 1") << 3 >> res;
+    CHECK(res == 4);
+  }
+}
@@ -0,0 +1,84 @@
+/*!
+ * \file explain_capture_test.cpp
+ *
+ * \date 2026-10-18
+ */
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+
+#include "../hdr/mariadb_modern_cpp/explain_capture.hpp"
+#include "test_config.hpp"
+
+TEST_CASE("explainable statements") {
+  CHECK(mariadb::detail::explainable("SELECT 1"));
+  CHECK(mariadb::detail::explainable(" (select 1) union (select 2)"));
+  CHECK(mariadb::detail::explainable("update t set a=1"));
+  CHECK(!mariadb::detail::explainable("do sleep(1)"));
+  CHECK(!mariadb::detail::explainable("selectx"));
+}
+
+TEST_CASE("explain capture") {
+  mariadb::database test_db(get_test_config());
+  mariadb::explain_capture_options options;
+  options.threshold = std::chrono::milliseconds(50);
+
+  SUBCASE("slow statements are explained") {
+    mariadb::explain_capture capture(get_test_config(), options);
+    CHECK_THROWS_AS(mariadb::explain_capture(get_test_config(), options),
+                    mariadb::mariadb_exception);
+
+    auto stmt = test_db << "select sleep(0.1),?";
+    stmt << "it's";
+    const auto digest = stmt.digest();
+    stmt.execute();
+    test_db << "select 1" >> [](int) {};
+    capture.flush();
+
+    const auto captures = capture.captures();
+    REQUIRE(captures.size() == 1);
+    CHECK(captures[0].digest == digest);
+    CHECK(captures[0].sql == "select sleep(0.1),'it\\'s'");
+    CHECK(captures[0].latency >= std::chrono::milliseconds(50));
+    CHECK(captures[0].plan.find("query_block") != std::string::npos);
+    CHECK(captures[0].error.empty());
+    CHECK(capture.stats().explained == 1);
+
+    // once per digest
+    test_db << "select sleep(0.1),?" << "again";
+    capture.flush();
+    CHECK(capture.captures().size() == 1);
+    CHECK(capture.stats().repeated == 1);
+
+    test_db << "do sleep(0.1)";
+    capture.flush();
+    REQUIRE(capture.captures().size() == 2);
+    CHECK(capture.captures()[1].plan.empty());
+    CHECK(capture.stats().failed == 1);
+  }
+
+  SUBCASE("cursor statements") {
+    mariadb::explain_capture capture(get_test_config(), options);
+    auto stmt = test_db << "select sleep(0.1) as c,?";
+    stmt.use_cursor(10);
+    stmt << 1 >> [](int, int) {};
+    capture.flush();
+
+    const auto captures = capture.captures();
+    REQUIRE(captures.size() == 1);
+    CHECK(captures[0].sql == "select sleep(0.1) as c,1");
+    CHECK(captures[0].latency >= std::chrono::milliseconds(50));
+    CHECK(captures[0].affected_rows == 0);
+  }
+
+  SUBCASE("rate limit") {
+    options.burst = 1;
+    options.rate = 0.001;
+    mariadb::explain_capture capture(get_test_config(), options);
+    test_db << "select sleep(0.06) as a";
+    test_db << "select sleep(0.06) as b";
+    capture.flush();
+    CHECK(capture.captures().size() == 1);
+    CHECK(capture.stats().slow == 2);
+    CHECK(capture.stats().rate_limited == 1);
+  }
+}
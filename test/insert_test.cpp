@@ -41,3 +41,44 @@ TEST_CASE("insert") {
     test_db << "drop TABLE mariadb_modern_cpp_test.tmp_table;";
   }
 }
+
+TEST_CASE("explicit statements") {
+  mariadb::database test_db(get_test_config());
+  test_db << "CREATE TABLE IF NOT EXISTS mariadb_modern_cpp_test.tmp_table "
+             "(id BIGINT PRIMARY KEY NOT NULL);";
+
+  static_assert(std::is_nothrow_destructible_v<mariadb::explicit_statement>);
+
+  SUBCASE("never executed implicitly") {
+    { auto stmt = test_db.statement("INSERT INTO tmp_table VALUES (1);"); }
+    size_t cnt = 1;
+    test_db << "select count(*) from tmp_table;" >> cnt;
+    CHECK(cnt == 0);
+  }
+
+  SUBCASE("duplicate key as a result") {
+    std::vector<mariadb::explicit_statement> statements;
+    for (int i = 0; i < 3; i++) {
+      statements.push_back(
+          test_db.statement("INSERT INTO tmp_table VALUES (?);"));
+    }
+    statements[0].bind(1);
+    statements[1].bind(2);
+    statements[2].bind(1);
+    CHECK(statements[0].try_execute());
+    CHECK(statements[1].try_execute());
+    auto res = statements[2].try_execute();
+    REQUIRE(!res);
+    CHECK(res.error().code() == 1062);
+    CHECK(res.error().sqlstate() == "23000");
+    CHECK(res.error().message().find("Duplicate") != std::string::npos);
+    const auto copy = res.error().with_kind(mariadb::error_kind::server);
+    CHECK(copy.message() == res.error().message());
+    CHECK_THROWS_AS(res.value(), mariadb::mariadb_exception);
+
+    auto unbound = test_db.statement("INSERT INTO tmp_table VALUES (?);");
+    CHECK(unbound.try_execute().error().code() == CR_PARAMS_NOT_BOUND);
+  }
+
+  test_db << "drop TABLE mariadb_modern_cpp_test.tmp_table;";
+}
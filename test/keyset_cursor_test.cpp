@@ -0,0 +1,74 @@
+/*!
+ * \file keyset_cursor_test.cpp
+ *
+ * \date 2026-10-18
+ */
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <cstddef>
+#include <doctest.h>
+
+#include "../hdr/mariadb_modern_cpp/bulk_loader.hpp"
+#include "../hdr/mariadb_modern_cpp/keyset_cursor.hpp"
+#include "test_config.hpp"
+
+TEST_CASE("keyset_cursor") {
+  auto config = get_test_config();
+  config.local_infile = true;
+  mariadb::database test_db(config);
+  mariadb::database prefetch_db(get_test_config());
+
+  test_db << "CREATE TABLE IF NOT EXISTS mariadb_modern_cpp_test.tmp_table "
+             "(grp VARCHAR(10), id BIGINT, value BIGINT, PRIMARY KEY(grp,id));";
+  std::vector<std::tuple<std::string, int64_t, int64_t>> rows;
+  for (int64_t i = 0; i < 1000; i++) {
+    rows.emplace_back(i % 2 ? "a" : "b", i, i * 3);
+  }
+  mariadb::bulk_loader(test_db).load("tmp_table", {"grp", "id", "value"},
+                                     rows);
+
+  using cursor_type = mariadb::keyset_cursor<2, std::string, int64_t, int64_t>;
+  const std::string query = "select grp,id,value from tmp_table";
+
+  SUBCASE("pages with prefetch") {
+    cursor_type cursor(test_db, prefetch_db, query, {"grp", "id"}, 64);
+    size_t count = 0;
+    std::optional<cursor_type::key_type> previous;
+    bool ordered = true;
+    while (true) {
+      const auto &page = cursor.next_page();
+      if (page.empty()) {
+        break;
+      }
+      CHECK(cursor.last_page_metrics().rows == page.size());
+      for (const auto &[grp, id, value] : page) {
+        cursor_type::key_type key(grp, id);
+        ordered = ordered && (!previous || *previous < key) && value == id * 3;
+        previous = key;
+        count++;
+      }
+    }
+    CHECK(ordered);
+    CHECK(count == 1000);
+  }
+
+  SUBCASE("resume from token") {
+    std::string token;
+    {
+      cursor_type cursor(test_db, query, {"grp", "id"}, 100);
+      cursor.next_page();
+      cursor.next_page();
+      token = cursor.token();
+    }
+    cursor_type cursor(test_db, query, {"grp", "id"}, 100);
+    cursor.resume(token);
+    const auto &page = cursor.next_page();
+    REQUIRE(page.size() == 100);
+    // 500 ids in each group,the third page starts in the first group
+    CHECK(std::get<0>(page.front()) == "a");
+    CHECK(std::get<1>(page.front()) == 401);
+
+    CHECK_THROWS_AS(cursor.resume("3:ab"), mariadb::mariadb_exception);
+  }
+
+  test_db << "drop TABLE mariadb_modern_cpp_test.tmp_table;";
+}
@@ -0,0 +1,95 @@
+/*!
+ * \file parallel_scan_test.cpp
+ *
+ * \date 2026-10-18
+ */
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <atomic>
+#include <cstddef>
+#include <doctest.h>
+
+#include "../hdr/mariadb_modern_cpp/bulk_loader.hpp"
+#include "../hdr/mariadb_modern_cpp/parallel_scan.hpp"
+#include "test_config.hpp"
+
+TEST_CASE("parallel_scan") {
+  auto config = get_test_config();
+  config.local_infile = true;
+  mariadb::database test_db(config);
+
+  test_db << "CREATE TABLE IF NOT EXISTS mariadb_modern_cpp_test.tmp_table "
+             "(id BIGINT PRIMARY KEY, value BIGINT NOT NULL);";
+  std::vector<std::tuple<int64_t, int64_t>> rows;
+  for (int64_t i = 0; i < 10000; i++) {
+    rows.emplace_back(i, i * 2);
+  }
+  mariadb::bulk_loader(test_db).load("tmp_table", {"id", "value"}, rows);
+
+  mariadb::connection_pool pool(get_test_config(), 4);
+  mariadb::parallel_scan_options options;
+  options.chunk_size = 333;
+  options.columns = "id,value";
+
+  SUBCASE("unordered") {
+    std::atomic<int64_t> sum{0};
+    std::atomic<size_t> count{0};
+    mariadb::parallel_scan(pool, "tmp_table", "id", 100, 9000,
+                           [&](int64_t, int64_t value) {
+                             sum += value;
+                             count++;
+                           },
+                           options);
+    CHECK(count == 8900);
+    CHECK(sum == (100 + 8999) * 8900);
+  }
+
+  SUBCASE("ordered with snapshot") {
+    options.order = mariadb::scan_order::ordered;
+    options.snapshot = mariadb::scan_snapshot::per_connection;
+    int64_t expected_id = 0;
+    bool in_order = true;
+    mariadb::parallel_scan(pool, "tmp_table", "id", 0, 20000,
+                           [&](int64_t id, int64_t value) {
+                             in_order = in_order && id == expected_id &&
+                                        value == id * 2;
+                             expected_id++;
+                           },
+                           options);
+    CHECK(in_order);
+    CHECK(expected_id == 10000);
+  }
+
+  SUBCASE("callback exception") {
+    CHECK_THROWS_AS(mariadb::parallel_scan(
+                        pool, "tmp_table", "id", 0, 10000,
+                        [](int64_t id, int64_t) {
+                          if (id == 5000) {
+                            throw std::runtime_error("stop");
+                          }
+                        },
+                        options),
+                    std::runtime_error);
+  }
+
+  SUBCASE("callback exception ends the snapshots") {
+    options.snapshot = mariadb::scan_snapshot::per_connection;
+    CHECK_THROWS_AS(mariadb::parallel_scan(
+                        pool, "tmp_table", "id", 0, 10000,
+                        [](int64_t id, int64_t) {
+                          if (id == 5000) {
+                            throw std::runtime_error("stop");
+                          }
+                        },
+                        options),
+                    std::runtime_error);
+    std::vector<mariadb::connection_pool::lease> leases;
+    for (size_t i = 0; i < pool.max_size(); i++) {
+      leases.push_back(pool.acquire());
+      int in_transaction = -1;
+      *leases.back() << "select @@in_transaction" >> in_transaction;
+      CHECK(in_transaction == 0);
+    }
+  }
+
+  test_db << "drop TABLE mariadb_modern_cpp_test.tmp_table;";
+}
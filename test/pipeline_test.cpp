@@ -0,0 +1,69 @@
+/*!
+ * \file pipeline_test.cpp
+ *
+ * \date 2026-10-18
+ */
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <atomic>
+#include <cstddef>
+#include <doctest.h>
+
+#include "../hdr/mariadb_modern_cpp/bulk_loader.hpp"
+#include "../hdr/mariadb_modern_cpp/pipeline.hpp"
+#include "test_config.hpp"
+
+TEST_CASE("pipelined_extract") {
+  auto config = get_test_config();
+  config.local_infile = true;
+  mariadb::database test_db(config);
+
+  test_db << "CREATE TABLE IF NOT EXISTS mariadb_modern_cpp_test.tmp_table "
+             "(id BIGINT PRIMARY KEY, name TEXT);";
+  std::vector<std::tuple<int64_t, std::optional<std::string>>> rows;
+  for (int64_t i = 0; i < 10000; i++) {
+    rows.emplace_back(i, i % 3 ? std::optional<std::string>(std::to_string(i))
+                               : std::nullopt);
+  }
+  mariadb::bulk_loader(test_db).load("tmp_table", {"id", "name"}, rows);
+
+  mariadb::pipeline_options options;
+  options.batch_rows = 100;
+  options.max_batches = 4;
+
+  SUBCASE("one consumer keeps order") {
+    int64_t expected_id = 0;
+    bool ok = true;
+    mariadb::pipelined_extract(
+        test_db << "select id,name from tmp_table order by id",
+        [&](int64_t id, std::optional<std::string> name) {
+          ok = ok && id == expected_id &&
+               name == std::get<1>(rows[static_cast<size_t>(id)]);
+          expected_id++;
+        },
+        options);
+    CHECK(ok);
+    CHECK(expected_id == 10000);
+  }
+
+  SUBCASE("several consumers") {
+    options.consumers = 4;
+    std::atomic<int64_t> sum{0};
+    mariadb::pipelined_extract(test_db << "select id from tmp_table",
+                               [&](int64_t id) { sum += id; }, options);
+    CHECK(sum == 9999 * 10000 / 2);
+  }
+
+  SUBCASE("exception propagation") {
+    options.consumers = 2;
+    CHECK_THROWS_AS(
+        mariadb::pipelined_extract(test_db << "select id,name from tmp_table",
+                                   [](int64_t, std::string) {}, options),
+        mariadb::exceptions::can_not_hold_null);
+    // the connection is usable afterwards
+    int64_t count = 0;
+    test_db << "select count(*) from tmp_table" >> count;
+    CHECK(count == 10000);
+  }
+
+  test_db << "drop TABLE mariadb_modern_cpp_test.tmp_table;";
+}
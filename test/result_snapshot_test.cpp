@@ -0,0 +1,73 @@
+/*!
+ * \file result_snapshot_test.cpp
+ *
+ * \date 2026-10-18
+ */
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <cstddef>
+#include <cstdio>
+#include <doctest.h>
+
+#include "../hdr/mariadb_modern_cpp/bulk_loader.hpp"
+#include "../hdr/mariadb_modern_cpp/result_snapshot.hpp"
+#include "test_config.hpp"
+
+TEST_CASE("result_snapshot") {
+  auto config = get_test_config();
+  config.local_infile = true;
+  mariadb::database test_db(config);
+
+  test_db << "CREATE TABLE IF NOT EXISTS mariadb_modern_cpp_test.tmp_table "
+             "(id BIGINT PRIMARY KEY, name VARCHAR(20), price DECIMAL(10,2));";
+  std::vector<std::tuple<int64_t, std::optional<std::string>, std::string>>
+      rows;
+  for (int64_t i = 0; i < 10000; i++) {
+    rows.emplace_back(i,
+                      i % 10 ? std::optional<std::string>(std::to_string(i))
+                             : std::nullopt,
+                      std::to_string(i) + ".50");
+  }
+  mariadb::bulk_loader(test_db).load("tmp_table", {"id", "name", "price"},
+                                     rows);
+
+  const std::string path = "result_snapshot_test.snapshot";
+  mariadb::save_snapshot(
+      test_db << "select id,name,price from tmp_table order by id", path, 1000);
+
+  mariadb::result_snapshot snapshot(path);
+  CHECK(snapshot.row_count() == rows.size());
+  CHECK(snapshot.column_count() == 3);
+  CHECK(std::string(snapshot.fields()[1].name) == "name");
+
+  SUBCASE("extract by callback") {
+    size_t count = 0;
+    bool same = true;
+    snapshot >> [&](int64_t id, std::optional<std::string> name,
+                    mariadb::decimal price) {
+      const auto &row = rows[count++];
+      same = same && id == std::get<0>(row) && name == std::get<1>(row) &&
+             price.to_string() == std::get<2>(row);
+    };
+    CHECK(count == rows.size());
+    CHECK(same);
+  }
+
+  SUBCASE("extract single row") {
+    mariadb::save_snapshot(test_db << "select count(*),max(id) from tmp_table",
+                           path);
+    mariadb::result_snapshot single(path);
+    size_t count = 0;
+    int64_t max_id = 0;
+    single >> std::tie(count, max_id);
+    CHECK(count == rows.size());
+    CHECK(max_id == 9999);
+  }
+
+  SUBCASE("NULL needs std::optional") {
+    CHECK_THROWS_AS(snapshot >> [](int64_t, std::string) {},
+                    mariadb::exceptions::can_not_hold_null);
+  }
+
+  std::remove(path.c_str());
+  test_db << "drop TABLE mariadb_modern_cpp_test.tmp_table;";
+}
@@ -4,13 +4,51 @@
  * \date 2018-07-06
  */
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <array>
 #include <cmath>
 #include <cstddef>
+#include <cstring>
 #include <doctest.h>
 
 #include "../hdr/mariadb_modern_cpp.hpp"
 #include "test_config.hpp"
 
+namespace {
+struct user_id {
+  int64_t value;
+};
+struct uuid {
+  std::array<std::byte, 16> bytes;
+};
+} // namespace
+
+template <> struct mariadb::type_converter<user_id> {
+  static void to_sql(sql_writer &out, const user_id &val) {
+    out.write_integer(val.value);
+  }
+  static conversion_status from_sql(const char *data, size_t size,
+                                    const MYSQL_FIELD &field, user_id &val) {
+    return type_converter<int64_t>::from_sql(data, size, field, val.value);
+  }
+};
+
+template <> struct mariadb::type_converter<uuid> {
+  static void to_sql(sql_writer &out, const uuid &val) {
+    out.write_string(val.bytes.data(), val.bytes.size());
+  }
+  static conversion_status from_sql(const char *data, size_t size,
+                                    const MYSQL_FIELD &, uuid &val) {
+    if (!data) {
+      return conversion_status::null_value;
+    }
+    if (size != val.bytes.size()) {
+      return conversion_status::failed;
+    }
+    std::memcpy(val.bytes.data(), data, size);
+    return conversion_status::ok;
+  }
+};
+
 TEST_CASE("select") {
   mariadb::database test_db(get_test_config());
 
@@ -130,6 +168,125 @@ TEST_CASE("select") {
         val;
     CHECK(std::fabs(val + 0.3) < 0.0000001);
   }
+  SUBCASE("extract DECIMAL by decimal") {
+    mariadb::decimal val;
+    test_db << "select dec_col from mariadb_modern_cpp_test.col_type_test "
+               "where id=?;"
+            << 1 >>
+        val;
+    CHECK(val == mariadb::decimal(-30, 2));
+    CHECK(val.to_string() == "-0.30");
+
+    size_t count = 0;
+    test_db << "select count(*) from mariadb_modern_cpp_test.col_type_test "
+               "where dec_col=?;"
+            << val >>
+        count;
+    CHECK(count == 1);
+  }
+
+  SUBCASE("extract DECIMAL with a high scale") {
+    mariadb::decimal zero;
+    mariadb::decimal small;
+    test_db << "select cast(0 as decimal(30,25)),"
+               "cast(-0.0000000000000000000000001 as decimal(30,25))" >>
+        std::tie(zero, small);
+    CHECK(zero.to_string() == "0.0000000000000000000000000");
+    CHECK(small == mariadb::decimal(-1, 25));
+    CHECK(small.to_string() == "-0.0000000000000000000000001");
+
+    mariadb::decimal val;
+    test_db << "select ?" << small >> val;
+    CHECK(val == small);
+    CHECK_THROWS_AS((mariadb::decimal(1, mariadb::decimal::max_scale + 1)),
+                    mariadb::mariadb_exception);
+  }
+
+  SUBCASE("extract DATE and DATETIME") {
+    using namespace std::chrono;
+    time_point<system_clock, seconds> date;
+    time_point<system_clock, microseconds> date_time;
+    test_db << "select date_col,datetime_col from "
+               "mariadb_modern_cpp_test.col_type_test where id=?;"
+            << 1 >>
+        std::tie(date, date_time);
+    CHECK(date.time_since_epoch() == seconds(1530835200));
+    CHECK(date_time - date == hours(1) + minutes(2) + seconds(3) +
+                                  microseconds(4));
+
+    size_t count = 0;
+    test_db << "select count(*) from mariadb_modern_cpp_test.col_type_test "
+               "where datetime_col=?;"
+            << date_time >>
+        count;
+    CHECK(count == 1);
+
+    test_db.prepare("select datetime_col from "
+                    "mariadb_modern_cpp_test.col_type_test where date_col=?")
+            << date >>
+        date_time;
+    CHECK(date_time - date == hours(1) + minutes(2) + seconds(3) +
+                                  microseconds(4));
+  }
+
+  SUBCASE("extract TIME") {
+    using namespace std::chrono;
+    microseconds val{};
+    test_db << "select time_col from mariadb_modern_cpp_test.col_type_test "
+               "where id=?;"
+            << 1 >>
+        val;
+    CHECK(val == -(hours(100) + minutes(2) + seconds(3) + milliseconds(500)));
+
+    test_db.prepare("select time_col from "
+                    "mariadb_modern_cpp_test.col_type_test where id=?")
+            << 1 >>
+        val;
+    CHECK(val == -(hours(100) + minutes(2) + seconds(3) + milliseconds(500)));
+  }
+
+  SUBCASE("extract BIT") {
+    std::bitset<10> val;
+    test_db << "select bit_col from mariadb_modern_cpp_test.col_type_test "
+               "where id=?;"
+            << 1 >>
+        val;
+    CHECK(val == std::bitset<10>("1000000001"));
+
+    size_t count = 0;
+    test_db << "select count(*) from mariadb_modern_cpp_test.col_type_test "
+               "where bit_col=?;"
+            << val >>
+        count;
+    CHECK(count == 1);
+  }
+
+  SUBCASE("extract DATE as string") {
+    std::string val;
+    test_db << "select date_col from mariadb_modern_cpp_test.col_type_test "
+               "where id=?;"
+            << 1 >>
+        val;
+    CHECK(val == "2018-07-06");
+  }
+
+  SUBCASE("bind and extract by user type_converter") {
+    test_db << "CREATE TABLE IF NOT EXISTS mariadb_modern_cpp_test.tmp_table "
+               "(id BIGINT, uid BINARY(16));";
+    uuid uid{};
+    uid.bytes[0] = std::byte{'\''};
+    uid.bytes[15] = std::byte{0xff};
+    test_db << "INSERT INTO tmp_table VALUES (?,?)" << user_id{3} << uid;
+
+    test_db << "select id,uid from mariadb_modern_cpp_test.tmp_table;" >>
+        [&](user_id id, std::optional<uuid> uid2) {
+          CHECK(id.value == 3);
+          REQUIRE(uid2.has_value());
+          CHECK(uid2->bytes == uid.bytes);
+        };
+    test_db << "drop TABLE mariadb_modern_cpp_test.tmp_table;";
+  }
+
   SUBCASE("extract VARCHAR") {
     std::string val;
     test_db << "select varchar_col from mariadb_modern_cpp_test.col_type_test "
@@ -183,6 +340,40 @@ TEST_CASE("select") {
     CHECK(has_exception);
   }
 
+  SUBCASE("errors without exceptions") {
+    int64_t val;
+    auto res = (test_db.statement("select null_col from "
+                                  "mariadb_modern_cpp_test.col_type_test "
+                                  "where id=?;")
+                << 1)
+                   .try_extract(val);
+    REQUIRE(!res);
+    CHECK(res.error().kind() == mariadb::error_kind::can_not_hold_null);
+
+    res = test_db.statement("select id from "
+                            "mariadb_modern_cpp_test.col_type_test where "
+                            "id<0;")
+              .try_extract(val);
+    REQUIRE(!res);
+    CHECK(res.error().kind() == mariadb::error_kind::no_rows);
+
+    size_t rows = 0;
+    res = test_db.statement("select id,varchar_col from "
+                            "mariadb_modern_cpp_test.col_type_test;")
+              .try_extract([&rows](int64_t, std::string) { rows++; });
+    CHECK(res);
+    CHECK(rows != 0);
+
+    res = test_db.statement("select no_such_col from "
+                            "mariadb_modern_cpp_test.col_type_test;")
+              .try_extract(val);
+    REQUIRE(!res);
+    CHECK(res.error().kind() == mariadb::error_kind::server);
+    CHECK(res.error().code() == 1054);
+    CHECK(res.error().sqlstate() == "42S22");
+    CHECK(!res.error().message().empty());
+  }
+
   SUBCASE("false optional type") {
     bool has_exception = false;
     try {
@@ -298,6 +489,67 @@ TEST_CASE("select") {
         };
   }
 
+  SUBCASE("extract by std::pmr types with arena") {
+    auto ps = test_db << "select longtext_col,longblob_col,null_col from "
+                         "mariadb_modern_cpp_test.col_type_test where id=?;";
+    ps.use_arena(mariadb::arena_reset::per_result_set);
+    ps << 1 >> [](std::pmr::string val, std::pmr::vector<std::byte> val2,
+             std::optional<std::pmr::string> val3) {
+      CHECK(val == "longtext");
+      CHECK(val2.size() == 8);
+      CHECK(!val3.has_value());
+      CHECK(val.get_allocator().resource() !=
+            std::pmr::get_default_resource());
+    };
+  }
+
+  SUBCASE("extract by server side cursor") {
+    auto ps = test_db << "select id,longtext_col,null_col from "
+                         "mariadb_modern_cpp_test.col_type_test union all "
+                         "select id,longtext_col,null_col from "
+                         "mariadb_modern_cpp_test.col_type_test;";
+    ps.use_cursor(1);
+    size_t rows = 0;
+    ps >> [&](int64_t id, std::string val, std::optional<std::string> val2) {
+      // the connection is free between fetches
+      std::string same;
+      test_db << "select longtext_col from "
+                 "mariadb_modern_cpp_test.col_type_test where id=?;"
+              << id >>
+          same;
+      CHECK(val == same);
+      CHECK(!val2.has_value());
+      rows++;
+    };
+    CHECK(rows == 2);
+
+    size_t count = 0;
+    auto single = test_db << "select count(*) from "
+                             "mariadb_modern_cpp_test.col_type_test where "
+                             "id=?;";
+    single.use_cursor();
+    single << 1 >> count;
+    CHECK(count == 1);
+  }
+
+  SUBCASE("deadline") {
+    const std::string sql = "select benchmark(100000000000,md5('x'));";
+    int64_t val = 0;
+    CHECK_THROWS_AS((test_db << sql).deadline(std::chrono::milliseconds(100)) >>
+                        val,
+                    mariadb::exceptions::deadline_exceeded);
+
+    auto stmt = test_db.statement(sql);
+    stmt.deadline(std::chrono::milliseconds(100), test_db.watchdog());
+    auto res = stmt.try_extract(val);
+    CHECK(!res);
+    CHECK(res.error().kind() == mariadb::error_kind::deadline_exceeded);
+
+    // the connection is left usable
+    test_db << "select 1;" >> val;
+    CHECK(val == 1);
+  }
+
   SUBCASE("select and extract LONGBLOB by std::vector<double>") {
     std::vector<double> val{1.0, 2.0, 0.0};
     size_t count = 0;
@@ -0,0 +1,91 @@
+/*!
+ * \file sharded_database_test.cpp
+ *
+ * \date 2026-10-18
+ */
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+
+#include "../hdr/mariadb_modern_cpp/sharded_database.hpp"
+#include "test_config.hpp"
+
+TEST_CASE("sharded_database") {
+  // three shards on the test server,so each row is returned three times
+  std::vector<mariadb::shard_config> configs(3);
+  for (size_t i = 0; i < configs.size(); i++) {
+    configs[i].name = "shard" + std::to_string(i);
+    configs[i].config = get_test_config();
+    configs[i].pool_size = 2;
+  }
+  mariadb::sharded_database shards(configs);
+  REQUIRE(shards.shard_count() == 3);
+
+  *shards.connection(0) << "CREATE TABLE IF NOT EXISTS "
+                           "mariadb_modern_cpp_test.tmp_table "
+                           "(id BIGINT PRIMARY KEY, name VARCHAR(20));";
+  for (int64_t id = 0; id < 100; id++) {
+    *shards.connection(id) << "insert into tmp_table values (?,?);" << id
+                           << std::to_string(id);
+  }
+
+  SUBCASE("keys map to shards consistently") {
+    std::vector<size_t> counts(shards.shard_count());
+    for (int64_t id = 0; id < 3000; id++) {
+      CHECK(shards.shard_of(id) == shards.shard_of(std::to_string(id)));
+      counts[shards.shard_of(id)]++;
+    }
+    for (auto count : counts) {
+      CHECK(count > 500);
+    }
+    // a fourth shard only takes keys,the others stay in place
+    configs.push_back(configs.back());
+    configs.back().name = "shard3";
+    mariadb::sharded_database more_shards(configs);
+    for (int64_t id = 0; id < 3000; id++) {
+      const auto shard = more_shards.shard_of(id);
+      CHECK((shard == 3 || shard == shards.shard_of(id)));
+    }
+  }
+
+  SUBCASE("scatter") {
+    size_t count = 0;
+    int64_t sum = 0;
+    mariadb::scatter_options options;
+    options.batch_rows = 7;
+    shards.scatter(
+        "select id,name from tmp_table where id < ?",
+        [&](int64_t id, std::string name) {
+          count++;
+          sum += id;
+          CHECK(name == std::to_string(id));
+        },
+        options, 50);
+    CHECK(count == 150);
+    CHECK(sum == 3 * 49 * 50 / 2);
+  }
+
+  SUBCASE("scatter_merge with limit") {
+    std::vector<int64_t> ids;
+    mariadb::scatter_options options;
+    options.limit = 10;
+    options.batch_rows = 2;
+    shards.scatter_merge(
+        "select id from tmp_table order by id desc;",
+        [&](int64_t id) { ids.push_back(id); },
+        [](auto &a, auto &b) { return a > b; }, options);
+    CHECK(ids == std::vector<int64_t>{99, 99, 99, 98, 98, 98, 97, 97, 97,
+                                      96});
+  }
+
+  SUBCASE("errors are rethrown") {
+    CHECK_THROWS_AS(shards.scatter("select id from no_such_table",
+                                   [](int64_t) {}),
+                    mariadb::mariadb_exception);
+    CHECK_THROWS_AS(
+        shards.scatter("select id from tmp_table",
+                       [](int64_t) { throw std::runtime_error("stop"); }),
+        std::runtime_error);
+  }
+
+  *shards.connection(0) << "drop TABLE mariadb_modern_cpp_test.tmp_table;";
+}
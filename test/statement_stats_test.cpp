@@ -0,0 +1,80 @@
+/*!
+ * \file statement_stats_test.cpp
+ *
+ * \date 2026-10-18
+ */
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <cstddef>
+#include <doctest.h>
+#include <thread>
+
+#include "../hdr/mariadb_modern_cpp.hpp"
+#include "test_config.hpp"
+
+TEST_CASE("sql digest") {
+  CHECK(mariadb::normalize_sql("SELECT a, b FROM `T` WHERE id = 42 AND "
+                               "name='x' /* c */ AND k IN (1, 2, 3)") ==
+        "select a,b from `T` where id=? and name=? and k in(?+)");
+  CHECK(mariadb::sql_digest("select * from t where id=1") ==
+        mariadb::sql_digest("SELECT *\n FROM t WHERE id = ?"));
+  CHECK(mariadb::sql_digest("select * from t where id=1") !=
+        mariadb::sql_digest("select * from t where name=1"));
+  // any run of literals collapses,not only IN lists
+  CHECK(mariadb::sql_digest("select 1,2") ==
+        mariadb::sql_digest("select 1,2,3"));
+  CHECK(mariadb::sql_digest("select 1") !=
+        mariadb::sql_digest("select 1,2"));
+}
+
+TEST_CASE("stats of exited threads") {
+  const std::string sql = "select 'stats of exited threads'";
+  const auto digest = mariadb::sql_digest(sql);
+  for (int i = 0; i < 4; i++) {
+    std::thread([&] {
+      mariadb::statement_stats::record(digest, sql,
+                                       std::chrono::milliseconds(i + 1), 2,
+                                       i == 0);
+    }).join();
+  }
+  bool found = false;
+  for (const auto &stats : mariadb::statement_stats::snapshot()) {
+    if (stats.digest == digest) {
+      found = true;
+      CHECK(stats.executions == 4);
+      CHECK(stats.errors == 1);
+      CHECK(stats.rows == 8);
+      CHECK(stats.total_latency == std::chrono::milliseconds(10));
+      CHECK(stats.max_latency == std::chrono::milliseconds(4));
+    }
+  }
+  CHECK(found);
+}
+
+TEST_CASE("statement stats") {
+  mariadb::database test_db(get_test_config());
+  mariadb::statement_stats::enable();
+
+  const std::string sql =
+      "select id from mariadb_modern_cpp_test.col_type_test where id=?";
+  int64_t id = 0;
+  for (int i = 0; i < 10; i++) {
+    test_db << sql << 1 >> id;
+  }
+  auto stmt = test_db << sql;
+  CHECK(stmt.digest() == mariadb::sql_digest(sql));
+  stmt.used(true);
+
+  bool found = false;
+  for (const auto &stats : mariadb::statement_stats::snapshot()) {
+    if (stats.digest == mariadb::sql_digest(sql)) {
+      found = true;
+      CHECK(stats.executions == 10);
+      CHECK(stats.rows == 10);
+      CHECK(stats.errors == 0);
+      CHECK(stats.max_latency.count() > 0);
+      CHECK(stats.sql == mariadb::normalize_sql(sql));
+    }
+  }
+  CHECK(found);
+  mariadb::statement_stats::enable(false);
+}
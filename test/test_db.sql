@@ -17,7 +17,11 @@ create table if not exists mariadb_modern_cpp_test.col_type_test (
   char_col CHAR(4) NOT NULL,
   longtext_col LONGTEXT NOT NULL,
   longblob_col LONGBLOB NOT NULL,
-  null_col LONGTEXT
+  null_col LONGTEXT,
+  date_col DATE,
+  datetime_col DATETIME(6),
+  time_col TIME(6),
+  bit_col BIT(10)
 );
 
-insert into mariadb_modern_cpp_test.col_type_test(id,int_col,uint_col,dec_col,udec_col,double_col,udouble_col,varchar_col,char_col,longtext_col,longblob_col,null_col) values(1,-1,1,-0.3,0.3,-0.3,0.3,"varchar","char","longtext","longblob",NULL);
+insert into mariadb_modern_cpp_test.col_type_test(id,int_col,uint_col,dec_col,udec_col,double_col,udouble_col,varchar_col,char_col,longtext_col,longblob_col,null_col,date_col,datetime_col,time_col,bit_col) values(1,-1,1,-0.3,0.3,-0.3,0.3,"varchar","char","longtext","longblob",NULL,"2018-07-06","2018-07-06 01:02:03.000004","-100:02:03.5",b'1000000001');
@@ -56,6 +56,20 @@ TEST_CASE("transaction") {
     test_db << "drop table mariadb_modern_cpp_test.tmp_table;";
   }
 
+  SUBCASE("statements of the context") {
+    test_db << "CREATE TABLE IF NOT EXISTS mariadb_modern_cpp_test.tmp_table "
+               "(id BIGINT PRIMARY KEY AUTO_INCREMENT NOT NULL);";
+    test_db << "delete from mariadb_modern_cpp_test.tmp_table;";
+    {
+      auto ctx = test_db.get_transaction_context();
+      ctx << "INSERT INTO tmp_table VALUES (?);" << 7;
+    }
+    size_t cnt = 0;
+    test_db << "select count(*) from tmp_table where id=?;" << 7 >> cnt;
+    CHECK(cnt == 1);
+    test_db << "drop table mariadb_modern_cpp_test.tmp_table;";
+  }
+
   SUBCASE("commit") {
     test_db << "CREATE TABLE IF NOT EXISTS mariadb_modern_cpp_test.tmp_table "
                "(id BIGINT PRIMARY KEY AUTO_INCREMENT NOT NULL);";
@@ -0,0 +1,152 @@
+/*!
+ * \file write_behind_test.cpp
+ *
+ * \date 2026-10-18
+ */
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <thread>
+#include <doctest.h>
+
+#include "../hdr/mariadb_modern_cpp/write_behind.hpp"
+#include "test_config.hpp"
+
+TEST_CASE("write_behind") {
+  mariadb::database test_db(get_test_config());
+  test_db << "CREATE TABLE IF NOT EXISTS mariadb_modern_cpp_test.tmp_table "
+             "(id BIGINT PRIMARY KEY, name VARCHAR(20), value DOUBLE);";
+
+  SUBCASE("rows from many threads") {
+    mariadb::write_behind_options options;
+    options.max_batch_rows = 100;
+    {
+      mariadb::write_behind<int64_t, std::string, std::optional<double>>
+          writer(get_test_config(), "tmp_table", {"id", "name", "value"},
+                 options);
+      std::vector<std::thread> threads;
+      for (int64_t t = 0; t < 4; t++) {
+        threads.emplace_back([&writer, t] {
+          for (int64_t i = 0; i < 1000; i++) {
+            writer.push(t * 1000 + i, "it's " + std::to_string(i),
+                        i % 2 ? std::optional<double>(0.5) : std::nullopt);
+          }
+        });
+      }
+      for (auto &thread : threads) {
+        thread.join();
+      }
+      writer.flush();
+      const auto stats = writer.stats();
+      CHECK(stats.accepted == 4000);
+      CHECK(stats.flushed == 4000);
+      CHECK(stats.queued == 0);
+      CHECK(stats.batches >= 40);
+
+      size_t count = 0;
+      test_db << "select count(*) from tmp_table where name like 'it''s %' "
+                 "and (value=0.5 or (value is null and id%2=0))" >>
+          count;
+      CHECK(count == 4000);
+
+      // written by the destructor
+      writer.push(int64_t(-1), std::string("last"), std::nullopt);
+    }
+    size_t count = 0;
+    test_db << "select count(*) from tmp_table where id=-1" >> count;
+    CHECK(count == 1);
+  }
+
+  SUBCASE("failed rows") {
+    std::vector<std::tuple<int64_t>> reported;
+    mariadb::write_behind<int64_t> writer(
+        get_test_config(), "no_such_table", {"id"}, {},
+        [&](const mariadb::mariadb_exception &,
+            const std::vector<std::tuple<int64_t>> &rows) {
+          reported.insert(reported.end(), rows.begin(), rows.end());
+        });
+    for (int64_t i = 0; i < 10; i++) {
+      writer.push(i);
+    }
+    writer.flush();
+    CHECK(writer.stats().failed == 10);
+    REQUIRE(reported.size() == 10);
+    CHECK(std::get<0>(reported[9]) == 9);
+  }
+
+  SUBCASE("retry rows") {
+    test_db << "insert into tmp_table (id) values (5)";
+    mariadb::write_behind_options options;
+    options.retry_rows = true;
+    std::vector<std::tuple<int64_t>> reported;
+    unsigned int error = 0;
+    mariadb::write_behind<int64_t> writer(
+        get_test_config(), "tmp_table", {"id"}, options,
+        [&](const mariadb::mariadb_exception &e,
+            const std::vector<std::tuple<int64_t>> &rows) {
+          error = e.get_errno();
+          reported.insert(reported.end(), rows.begin(), rows.end());
+        });
+    for (int64_t i = 0; i < 10; i++) {
+      writer.push(i);
+    }
+    writer.flush();
+    const auto stats = writer.stats();
+    CHECK(stats.flushed == 9);
+    CHECK(stats.failed == 1);
+    REQUIRE(reported.size() == 1);
+    CHECK(std::get<0>(reported[0]) == 5);
+    CHECK(error == 1062);
+  }
+
+  SUBCASE("drop_newest") {
+    mariadb::write_behind_options options;
+    options.capacity = 2;
+    options.overflow = mariadb::overflow_policy::drop_newest;
+    options.flush_interval = std::chrono::hours(1);
+    mariadb::write_behind<int64_t> writer(get_test_config(), "tmp_table",
+                                          {"id"}, options);
+    size_t accepted = 0;
+    for (int64_t i = 0; i < 1000; i++) {
+      accepted += writer.push(i) ? 1 : 0;
+    }
+    writer.flush();
+    const auto stats = writer.stats();
+    CHECK(stats.accepted == accepted);
+    CHECK(stats.dropped == 1000 - accepted);
+    CHECK(stats.flushed == accepted);
+  }
+
+  SUBCASE("flush while pushing") {
+    mariadb::write_behind_options options;
+    options.capacity = 64;
+    options.max_batch_rows = 1000;
+    options.overflow = mariadb::overflow_policy::drop_oldest;
+    // only a flush or a full batch wakes the writer
+    options.flush_interval = std::chrono::hours(1);
+    mariadb::write_behind<int64_t> writer(get_test_config(), "tmp_table",
+                                          {"id"}, options);
+    std::vector<std::thread> threads;
+    for (int64_t t = 0; t < 4; t++) {
+      threads.emplace_back([&writer, t] {
+        for (int64_t i = 0; i < 5000; i++) {
+          writer.push(t * 5000 + i);
+        }
+      });
+    }
+    for (int i = 0; i < 50; i++) {
+      const auto accepted = writer.stats().accepted;
+      writer.flush();
+      const auto stats = writer.stats();
+      CHECK(stats.flushed + stats.failed + stats.dropped >= accepted);
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    writer.flush();
+    const auto stats = writer.stats();
+    CHECK(stats.accepted == 20000);
+    CHECK(stats.flushed + stats.dropped == 20000);
+    CHECK(stats.queued == 0);
+  }
+
+  test_db << "drop TABLE mariadb_modern_cpp_test.tmp_table;";
+}